@@ -639,13 +639,22 @@ macro(CheckArcan)
       set(HAVE_SDL_AUDIO TRUE)
 
       file(GLOB ARCAN_SOURCES ${SDL2_SOURCE_DIR}/src/video/arcan/*.c ${SDL2_SOURCE_DIR}/src/audio/arcan/*.c)
+      if(SDL_JOYSTICK)
+        file(GLOB ARCAN_JOYSTICK_SOURCES ${SDL2_SOURCE_DIR}/src/joystick/arcan/*.c)
+        list(APPEND ARCAN_SOURCES ${ARCAN_JOYSTICK_SOURCES})
+        set(SDL_JOYSTICK_ARCAN 1)
+      endif()
+      if(SDL_RENDER)
+        file(GLOB ARCAN_RENDER_SOURCES ${SDL2_SOURCE_DIR}/src/render/arcan/*.c)
+        list(APPEND ARCAN_SOURCES ${ARCAN_RENDER_SOURCES})
+        set(SDL_VIDEO_RENDER_ARCAN 1)
+      endif()
       set(SOURCE_FILES ${SOURCE_FILES} ${ARCAN_SOURCES})
 
       list(APPEND EXTRA_LDFLAGS ${PKG_ASHMIF_LDFLAGS})
 
       set(SDL_VIDEO_DRIVER_ARCAN 1)
       set(SDL_AUDIO_DRIVER_ARCAN 1) # they come together
-      list(APPEND EXTRA_CFLAGS "-DSDL_VIDEO_DRIVER_ARCAN -DSDL_AUDIO_DRIVER_ARCAN")
     endif()
   endif()
 endmacro()
@@ -217,6 +217,143 @@ extern "C" {
  */
 #define SDL_HINT_APPLE_TV_REMOTE_ALLOW_ROTATION "SDL_APPLE_TV_REMOTE_ALLOW_ROTATION"
 
+/**
+ * A variable controlling whether the Arcan audio driver mixes directly into
+ * the shared audio buffer of the connection.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Mix into a private buffer that is copied over (the default).
+ * - "1": Hand the audio callback a pointer into the shared buffer whenever a
+ *   full period fits, avoiding the copy.
+ *
+ * This hint should be set before opening the audio device.
+ */
+#define SDL_HINT_ARCAN_AUDIO_DIRECT "SDL_ARCAN_AUDIO_DIRECT"
+
+/**
+ * A variable setting the output latency, in milliseconds, that the Arcan
+ * audio driver aims for.
+ *
+ * When set, the number of buffers queued to the server starts out covering
+ * this latency, grows when the server runs out of audio and shrinks back
+ * towards the target once playback has been stable for a while. When not
+ * set, a fixed amount of buffering is used (the default).
+ *
+ * The current estimate can be read from the arcan part of SDL_SysWMinfo.
+ *
+ * This hint should be set before opening the audio device.
+ */
+#define SDL_HINT_ARCAN_AUDIO_LATENCY "SDL_ARCAN_AUDIO_LATENCY"
+
+/**
+ * A variable controlling whether the Arcan video driver detects changed
+ * regions of the window surface on its own.
+ *
+ * When enabled, the driver keeps a checksum for each tile of the previously
+ * presented frame and only synchronizes the area spanned by the tiles that
+ * changed, even if the application updates the whole surface with
+ * SDL_UpdateWindowSurface(). Each present is sent as a single region, so
+ * this pays off most when the changes are close together.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Only the rectangles passed by the application are used (the default).
+ * - "1": Changed tiles are detected by comparing against the previous frame.
+ *
+ * This hint should be set before the window surface is created.
+ */
+#define SDL_HINT_ARCAN_DAMAGE_TRACKING "SDL_ARCAN_DAMAGE_TRACKING"
+
+/**
+ * A variable controlling whether Arcan windows ask the server to pace them.
+ *
+ * Paced windows hold each present back until the server asks for the next
+ * frame through a step, so they run at the rate the window is actually
+ * shown. A window the server steps on its own accord is paced regardless of
+ * this hint. The number of frames presented so far can be read from the
+ * arcan part of SDL_SysWMinfo.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Present whenever the application does (the default).
+ * - "1": Request a frame step for every display refresh.
+ *
+ * This hint should be set before creating the window.
+ */
+#define SDL_HINT_ARCAN_FRAME_PACING "SDL_ARCAN_FRAME_PACING"
+
+/**
+ * A variable controlling whether the Arcan video driver coalesces mouse
+ * motion.
+ *
+ * When coalescing, all motion samples that arrive in one event pump are
+ * merged into a single motion event, summing the relative deltas and keeping
+ * the latest absolute position. Motion is still delivered ahead of any button
+ * or wheel event that follows it.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Send a motion event for every sample from the server.
+ * - "1": Send at most one motion event per pump and button (the default).
+ */
+#define SDL_HINT_ARCAN_MOUSE_COALESCE "SDL_ARCAN_MOUSE_COALESCE"
+
+/**
+ * A variable controlling how the Arcan video driver presents the window
+ * surface.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "block": One buffer, each update waits for the server to consume the
+ *   frame (the default).
+ * - "queue": Two buffers, an update only waits when the server still holds
+ *   the previous frame.
+ * - "drop": Three buffers, updates never wait and the server shows the most
+ *   recent frame, dropping older ones.
+ *
+ * This hint should be set before creating the window.
+ */
+#define SDL_HINT_ARCAN_PRESENT_MODE "SDL_ARCAN_PRESENT_MODE"
+
+/**
+ * A variable controlling whether the Arcan video driver records the main
+ * window.
+ *
+ * When enabled, an extra output segment is requested from the server and
+ * every frame presented through the window surface, along with the audio
+ * played on the main connection, is copied to it with the same timestamps,
+ * for the server to encode. Frames the server has not consumed in time are
+ * merged into the next one rather than stalling the application.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Don't record (the default).
+ * - "1": Record the main window and its audio.
+ *
+ * This hint should be set before the video subsystem is initialized.
+ */
+#define SDL_HINT_ARCAN_RECORD "SDL_ARCAN_RECORD"
+
+/**
+ * A variable controlling whether the Arcan video driver lets the server scale
+ * fullscreen windows.
+ *
+ * By default a window going fullscreen is resized to the size of the display,
+ * so an application drawing at a smaller logical size (for example through
+ * SDL_RenderSetLogicalSize) has every pixel scaled up on the CPU. With this
+ * enabled the window keeps its size and the server is asked to scale it when
+ * composing instead.
+ *
+ * This variable can be set to the following values:
+ *
+ * - "0": Fullscreen windows are resized to the display (the default).
+ * - "1": Fullscreen windows keep their size and are scaled by the server.
+ *
+ * This hint is checked when a window enters fullscreen.
+ */
+#define SDL_HINT_ARCAN_SERVER_SCALE "SDL_ARCAN_SERVER_SCALE"
+
 /**
  * A variable controlling the audio category on iOS and Mac OS X
  *
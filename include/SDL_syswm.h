@@ -120,6 +120,10 @@ typedef void *EGLSurface;
 struct gbm_device;
 #endif
 
+#if defined(SDL_VIDEO_DRIVER_ARCAN)
+struct arcan_shmif_cont;
+#endif
+
 
 #include "begin_code.h"
 /* Set up for C function definitions, even when using C++ */
@@ -148,7 +152,8 @@ typedef enum SDL_SYSWM_TYPE
     SDL_SYSWM_OS2,
     SDL_SYSWM_HAIKU,
     SDL_SYSWM_KMSDRM,
-    SDL_SYSWM_RISCOS
+    SDL_SYSWM_RISCOS,
+    SDL_SYSWM_ARCAN
 } SDL_SYSWM_TYPE;
 
 /**
@@ -343,6 +348,18 @@ struct SDL_SysWMinfo
         } kmsdrm;
 #endif
 
+#if defined(SDL_VIDEO_DRIVER_ARCAN)
+        struct
+        {
+            struct arcan_shmif_cont *segment;  /**< The shmif segment backing the window */
+            Uint32 audio_underruns;            /**< Times the server ran out of queued audio */
+            Uint32 audio_latency;              /**< Estimated audio output latency in milliseconds */
+            Uint32 frame_count;                /**< Frames presented in the window */
+            Uint64 presented_pts;              /**< Timestamp of the last frame the server picked up */
+            Uint64 presented_at;               /**< SDL_GetTicks64() when that was noticed */
+        } arcan;
+#endif
+
         /* Make sure this union is always 64 bytes (8 64-bit pointers). */
         /* Be careful not to overflow this if you add a new target! */
         Uint8 dummy[64];
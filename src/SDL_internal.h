@@ -160,6 +160,14 @@
 #ifndef SDL_VIDEO_RENDER_VITA_GXM
 #define SDL_VIDEO_RENDER_VITA_GXM 0
 #endif
+#ifndef SDL_VIDEO_RENDER_ARCAN
+#define SDL_VIDEO_RENDER_ARCAN 0
+#endif
+/* the arcan renderer is built on top of the software one */
+#if !SDL_VIDEO_RENDER_SW
+#undef SDL_VIDEO_RENDER_ARCAN
+#define SDL_VIDEO_RENDER_ARCAN 0
+#endif
 #else /* define all as 0 */
 #undef SDL_VIDEO_RENDER_SW
 #define SDL_VIDEO_RENDER_SW 0
@@ -185,6 +193,8 @@
 #define SDL_VIDEO_RENDER_PSP 0
 #undef SDL_VIDEO_RENDER_VITA_GXM
 #define SDL_VIDEO_RENDER_VITA_GXM 0
+#undef SDL_VIDEO_RENDER_ARCAN
+#define SDL_VIDEO_RENDER_ARCAN 0
 #endif /* SDL_RENDER_DISABLED */
 
 #define SDL_HAS_RENDER_DRIVER \
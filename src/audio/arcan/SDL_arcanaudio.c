@@ -16,17 +16,62 @@
 #include <arcan_shmif.h>
 
 #include "SDL_timer.h"
+#include "SDL_hints.h"
+#include "SDL_cpuinfo.h"
 #include "SDL_audio.h"
 #include "SDL_arcanaudio.h"
 #include "SDL_video.h"
 #include "SDL_stdinc.h"
 #include "../../video/arcan/SDL_arcanvideo.h"
+#include "../../video/arcan/SDL_arcanrecord.h"
 #include "../SDL_audio_c.h"
 #include "../SDL_audiodev_c.h"
 
+/* segment request ids for the audio subsegments, see requestSegment */
+#define ARCAN_CAPTURE_REQID 0xca97e000
+#define ARCAN_PLAYBACK_REQID 0xa0d10000
+
+/* ms capture sleeps on the audio semaphore before checking for shutdown */
+#define ARCAN_CAPTURE_WAIT 100
+
+/* seconds of playback without underruns before giving a buffer back */
+#define ARCAN_ABUF_SETTLE 2
+
+#ifdef __SSE2__
+#define HAVE_SSE2_INTRINSICS 1
+#endif
+
+#ifdef __ARM_NEON
+#define HAVE_NEON_INTRINSICS 1
+#endif
+
+/*
+ * There is just the one connection, but unlike OnlyHasDefaultOutputDevice
+ * this lets the output be opened more than once, see Arcan_OpenDevice.
+ */
 static void
 Arcan_DetectDevices(void)
 {
+    SDL_AddAudioDevice(SDL_FALSE, DEFAULT_OUTPUT_DEVNAME, NULL, (void *) ((size_t) 0x1));
+    SDL_AddAudioDevice(SDL_TRUE, DEFAULT_INPUT_DEVNAME, NULL, (void *) ((size_t) 0x2));
+}
+
+/*
+ * shmif_asample is picked when the shmif library is built, so is its format.
+ * The float test works since converting 0.5 to any integer type yields 0.
+ */
+static SDL_AudioFormat
+Arcan_NativeFormat(void)
+{
+    const SDL_bool is_float = ((shmif_asample) 0.5f) != 0;
+
+    if (is_float && sizeof(shmif_asample) == 4){
+        return AUDIO_F32SYS;
+    }
+    if (!is_float && sizeof(shmif_asample) == 4){
+        return AUDIO_S32SYS;
+    }
+    return AUDIO_S16SYS;
 }
 
 static void
@@ -34,38 +79,105 @@ Arcan_CloseDevice(_THIS)
 {
     struct arcan_shmif_cont *acont = arcan_shmif_primary(SHMIF_INPUT);
     Arcan_SDL_Meta *cont = (Arcan_SDL_Meta*) acont->user;
-    int refc;
 
-    /* either audio or video or "other" can be last */
-    SDL_LockMutex(cont->av_sync);
-    cont->refc--;
-    refc = cont->refc;
-    SDL_UnlockMutex(cont->av_sync);
+    /* the audio thread is gone, don't leave a resize waiting on it */
+    if (this->hidden->direct && this->hidden->out == &cont->mcont){
+        SDL_AtomicSet(&cont->audio_busy, 0);
+    }
+    this->hidden->direct = NULL;
 
-    if (0 == refc){
-        SDL_DestroyMutex(cont->av_sync);
-        arcan_shmif_drop(acont);
-        arcan_shmif_setprimary(SHMIF_INPUT, NULL);
-        SDL_free(cont);
+    /* let the next playback device have the primary segment */
+    if (this->hidden->out == &cont->mcont){
+        SDL_AtomicSet(&cont->audio_primary, 0);
+    }
+
+    /* subsegments go before the primary they were derived from */
+    if (this->hidden->seg.addr){
+        arcan_shmif_drop(&this->hidden->seg);
+    }
+
+    /* either audio or video or "other" can be last */
+    if (SDL_AtomicDecRef(&cont->refc)){
+        arcan_av_teardown(cont);
     }
 
     SDL_free(this->hidden->mixbuf);
     this->hidden = NULL;
 }
 
+/*
+ * Ask for an audio carrying subsegment of the primary and block until the
+ * server has answered. Like GL windows, the segment must exist before we can
+ * report a spec.
+ */
+static int
+requestSegment(_THIS, Arcan_SDL_Meta *cont, int kind, Uint32 id)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+    struct arcan_event acqev = {
+        .category = EVENT_EXTERNAL,
+        .ext.kind = ARCAN_EVENT(SEGREQ),
+        .ext.segreq.width = 1,
+        .ext.segreq.height = 1,
+        .ext.segreq.kind = kind,
+        .ext.segreq.id = id
+    };
+
+    arcan_shmif_enqueue(&cont->mcont, &acqev);
+
+/* FIXME: same pqueue caveat as in Arcan_CreateWindow */
+    if (!arcan_shmif_acquireloop(&cont->mcont,
+                                 &acqev, &cont->pqueue, &cont->pqueue_sz)){
+        if (!cont->pqueue || cont->pqueue_sz < 0){
+            return SDL_SetError("Shmif- state inconsistent");
+        }
+        return SDL_SetError("Arcan rejected audio segment request");
+    }
+
+    adata->seg = arcan_shmif_acquire(&cont->mcont, NULL, kind, 0);
+    if (!adata->seg.addr){
+        return SDL_SetError("Couldn't map audio segment");
+    }
+    return 0;
+}
+
+/*
+ * Capture comes from an encoder subsegment, the server fills its audio buffer
+ * and flags aready, we read straight out of audp and hand the buffer back.
+ */
+static int
+Arcan_OpenCapture(_THIS, Arcan_SDL_Meta *cont)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+
+    if (requestSegment(this, cont, SEGID_ENCODER, ARCAN_CAPTURE_REQID) != 0){
+        return -1;
+    }
+
+    this->spec.channels = ARCAN_SHMIF_ACHANNELS;
+    this->spec.format = Arcan_NativeFormat();
+    this->spec.freq = adata->seg.samplerate > 0 ?
+                      adata->seg.samplerate : ARCAN_SHMIF_SAMPLERATE;
+    SDL_CalculateAudioSpec(&this->spec);
+    return 0;
+}
+
 static int
 Arcan_OpenDevice(_THIS, const char *devname)
 {
     Arcan_SDL_Meta *cont;
     struct shmif_resize_ext ext;
-    struct arcan_shmif_cont *shmcont;
+    struct arcan_shmif_cont *shmcont, *out;
+    int want_freq = this->spec.freq;
+    const char *latency_hint = SDL_GetHint(SDL_HINT_ARCAN_AUDIO_LATENCY);
+    int latency = latency_hint ? SDL_atoi(latency_hint) : 0;
 
     if (!getenv("ARCAN_CONNPATH")){
         return SDL_SetError("No arcan connection (ARCAN_CONNPATH env.)");
     }
 
     /* this depends on initialization order, if video comes first, we already
-     * have a primary segment ready to use (and we do no audio on the secondary
+     * have a primary segment ready to use (and we do no audio on the window
      * ones) */
     if (!arcan_shmif_primary(SHMIF_INPUT)){
         if (0 != arcan_av_setup_primary()){
@@ -75,20 +187,24 @@ Arcan_OpenDevice(_THIS, const char *devname)
 
     shmcont = arcan_shmif_primary(SHMIF_INPUT);
     cont = (Arcan_SDL_Meta*) shmcont->user;
-    SDL_LockMutex(cont->av_sync);
-    cont->refc++;
-    SDL_UnlockMutex(cont->av_sync);
+    SDL_AtomicIncRef(&cont->refc);
 
-    /* we only support one spec */
+    /* channels and sample format are fixed by the shmif build, rate is negotiated */
     this->hidden = (struct SDL_PrivateAudioData *)
         SDL_malloc((sizeof *this->hidden));
     if (this->hidden == NULL) {
         return SDL_OutOfMemory();
     }
     SDL_memset(this->hidden, 0, (sizeof *this->hidden));
+    if (this->iscapture){
+        return Arcan_OpenCapture(this, cont);
+    }
+
     this->spec.channels= ARCAN_SHMIF_ACHANNELS;
-    this->spec.format = AUDIO_S16LSB;
-    this->spec.freq = ARCAN_SHMIF_SAMPLERATE;
+    this->spec.format = Arcan_NativeFormat();
+    if (want_freq <= 0){
+        want_freq = ARCAN_SHMIF_SAMPLERATE;
+    }
     SDL_CalculateAudioSpec(&this->spec);
 
     /* Unfortunately we need an intermediate buffer here as we never know
@@ -97,19 +213,286 @@ Arcan_OpenDevice(_THIS, const char *devname)
     this->hidden->mixbuf = (Uint8 *) SDL_malloc(this->hidden->mixlen);
     SDL_memset(this->hidden->mixbuf, this->spec.silence, this->spec.size);
 
-    SDL_LockMutex(cont->av_sync);
+    /* the first playback device shares the primary segment with video, any
+     * further ones get an audio subsegment each so the server does the mixing
+     * and no device ever waits on another one's callback */
+    if (SDL_AtomicCAS(&cont->audio_primary, 0, 1)){
+        this->hidden->out = shmcont;
+    }
+    else {
+        if (requestSegment(this, cont, SEGID_MEDIA, ARCAN_PLAYBACK_REQID) != 0){
+            return -1;
+        }
+        this->hidden->out = &this->hidden->seg;
+    }
+    out = this->hidden->out;
+
+    arcan_av_resize_begin(cont, out);
 
     /* Still no guarantee that we'll get this size, so it is not safe to
      * assume that we do. Buffering parameters can be adjusted at resize
-     * and is controlled server-side */
-    ext.abuf_sz = this->hidden->mixlen;
-    ext.abuf_cnt = 65536 / ext.abuf_sz;
-    ext.vbuf_cnt = -1;
-    arcan_shmif_resize_ext(shmcont, shmcont->w, shmcont->h, ext);
-    SDL_UnlockMutex(cont->av_sync);
+     * and is controlled server-side. Ask for the rate the application wants
+     * so SDL doesn't need to resample, what the server actually agreed to is
+     * reflected in the segment. Unnamed fields start out zeroed. */
+    ext = (struct shmif_resize_ext){
+        .abuf_sz = this->hidden->mixlen,
+        .abuf_cnt = 65536 / this->hidden->mixlen,
+        .vbuf_cnt = -1,
+        .samplerate = want_freq
+    };
+
+    /* with a latency target, start with as many periods as cover it and let
+     * signalBuffer adjust from there */
+    if (latency > 0){
+        int frames = (int) (((Sint64) latency * want_freq) / 1000);
+        this->hidden->adaptive = SDL_TRUE;
+        this->hidden->abuf_min = SDL_max(2,
+            (frames + this->spec.samples - 1) / this->spec.samples);
+        this->hidden->abuf_max = SDL_max(this->hidden->abuf_min * 4,
+                                         (int) ext.abuf_cnt);
+        ext.abuf_cnt = this->hidden->abuf_min;
+    }
+    this->hidden->abuf_cnt = ext.abuf_cnt;
+    arcan_shmif_resize_ext(out, out->w, out->h, ext);
+    this->spec.freq = out->samplerate > 0 ?
+                      out->samplerate : ARCAN_SHMIF_SAMPLERATE;
+    arcan_av_resize_end(cont, out);
+
+    this->hidden->use_direct =
+        SDL_GetHintBoolean(SDL_HINT_ARCAN_AUDIO_DIRECT, SDL_FALSE);
+    this->hidden->gen = SDL_AtomicGet(&cont->audio_gen) - 1;
     return 0;
 }
 
+/*
+ * Mark the audio thread as using audp, fails if the primary segment is in the
+ * middle of a resize and the buffer may be about to move. Subsegments are
+ * only ever resized by their own device.
+ */
+static SDL_bool
+claimBuffer(_THIS, Arcan_SDL_Meta *cont)
+{
+    if (this->hidden->out != &cont->mcont){
+        return SDL_TRUE;
+    }
+
+    SDL_AtomicSet(&cont->audio_busy, 1);
+    if (SDL_AtomicGet(&cont->audio_resize)){
+        SDL_AtomicSet(&cont->audio_busy, 0);
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+static void
+releaseBuffer(_THIS, Arcan_SDL_Meta *cont)
+{
+    if (this->hidden->out == &cont->mcont){
+        SDL_AtomicSet(&cont->audio_busy, 0);
+    }
+}
+
+/*
+ * SDL_ARCAN_AUDIO_LATENCY: an underrun asks for one more buffer right away,
+ * a few seconds without one gives a buffer back until we are at the target.
+ */
+static void
+adaptCount(_THIS, SDL_bool underrun, int per_buffer)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+
+    if (underrun){
+        adata->calm = 0;
+        if (adata->abuf_cnt < adata->abuf_max){
+            adata->want_cnt = adata->abuf_cnt + 1;
+        }
+        return;
+    }
+
+    if (++adata->calm * per_buffer >= ARCAN_ABUF_SETTLE * this->spec.freq){
+        adata->calm = 0;
+        if (adata->abuf_cnt > adata->abuf_min){
+            adata->want_cnt = adata->abuf_cnt - 1;
+        }
+    }
+}
+
+/*
+ * Hand a full buffer to the server. It had up to abuf_cnt buffers queued at
+ * the previous signal, if more time than it takes to play those has passed
+ * since, it ran dry in between and that counts as an underrun.
+ */
+static void
+signalBuffer(_THIS, Arcan_SDL_Meta *cont)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+    struct arcan_shmif_cont *out = adata->out;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const int frame_sz =
+        (SDL_AUDIO_BITSIZE(this->spec.format) / 8) * this->spec.channels;
+    const int per_buffer = (int) (out->abufsize / frame_sz);
+    const int cnt = out->abuf_cnt > 0 ? out->abuf_cnt : adata->abuf_cnt;
+    SDL_bool underrun = SDL_FALSE;
+
+    if (this->spec.freq <= 0 || per_buffer <= 0){
+        arcan_shmif_signal(out, SHMIF_SIGAUD);
+        return;
+    }
+
+    if (adata->last_signal){
+        const Uint64 limit = (Uint64) SDL_max(cnt, 1) * per_buffer *
+                             SDL_GetPerformanceFrequency() / this->spec.freq;
+        if (now - adata->last_signal > limit){
+            SDL_AtomicIncRef(&cont->audio_underruns);
+            underrun = SDL_TRUE;
+        }
+    }
+
+    /* the first sample of this buffer plays when everything before it has, an
+     * underrun means the server waited for us so restart the clock from now */
+    if (!adata->apts_base || underrun){
+        adata->apts_base = SDL_GetTicks64();
+        adata->frames_out = 0;
+    }
+    out->addr->apts = adata->apts_base +
+                      adata->frames_out * 1000 / this->spec.freq;
+    adata->frames_out += per_buffer;
+
+    /* SDL_ARCAN_RECORD gets the buffer as mixed, before it is handed off */
+    if (out == &cont->mcont){
+        Arcan_RecordAudio(cont, (const Uint8*) out->audp, out->abufsize,
+                          frame_sz, this->spec.freq, out->addr->apts);
+    }
+
+    arcan_shmif_signal(out, SHMIF_SIGAUD);
+    adata->last_signal = SDL_GetPerformanceCounter();
+
+    /* what is queued server side plus the period SDL is mixing ahead */
+    SDL_AtomicSet(&cont->audio_latency, (int)
+        (((Sint64) cnt * per_buffer + this->spec.samples) * 1000 /
+         this->spec.freq));
+
+    if (adata->adaptive){
+        adaptCount(this, underrun, per_buffer);
+    }
+}
+
+/*
+ * Apply a buffer count change from adaptCount, at a buffer boundary and with
+ * audp released. With a window on the primary, the video thread may be
+ * drawing into vidp, so there the event pump does it for us.
+ */
+static void
+applyCount(_THIS, Arcan_SDL_Meta *cont)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+
+    if (!adata->want_cnt || adata->out->abufused){
+        return;
+    }
+
+    adata->abuf_cnt = adata->want_cnt;
+    adata->want_cnt = 0;
+
+    if (adata->out == &cont->mcont && cont->main){
+        SDL_AtomicSet(&cont->audio_abuf_cnt, adata->abuf_cnt);
+        return;
+    }
+
+    arcan_av_resize_audio(cont, adata->out, adata->abuf_cnt);
+    adata->gen = SDL_AtomicGet(&cont->audio_gen) - 1;
+}
+
+/*
+ * Copy [len] bytes of samples from [src] to [dst] scaled by [gain] (16.16
+ * fixed point, below unity). The two may be the same buffer.
+ */
+static void
+scaleSamples(SDL_AudioFormat fmt, Uint8 *dst, const Uint8 *src,
+             size_t len, int gain)
+{
+    size_t i = 0;
+
+    if (SDL_AUDIO_ISFLOAT(fmt)){
+        const float fg = (float) gain / 65536.0f;
+        const size_t n = len / sizeof(float);
+        float *d = (float*) dst;
+        const float *s = (const float*) src;
+#if defined(HAVE_SSE2_INTRINSICS)
+        if (SDL_HasSSE2()){
+            const __m128 g = _mm_set1_ps(fg);
+            for (; i + 4 <= n; i += 4){
+                _mm_storeu_ps(&d[i], _mm_mul_ps(_mm_loadu_ps(&s[i]), g));
+            }
+        }
+#elif defined(HAVE_NEON_INTRINSICS)
+        if (SDL_HasNEON()){
+            for (; i + 4 <= n; i += 4){
+                vst1q_f32(&d[i], vmulq_n_f32(vld1q_f32(&s[i]), fg));
+            }
+        }
+#endif
+        for (; i < n; i++){
+            d[i] = s[i] * fg;
+        }
+    }
+    else if (SDL_AUDIO_BITSIZE(fmt) == 32){
+        const size_t n = len / sizeof(Sint32);
+        Sint32 *d = (Sint32*) dst;
+        const Sint32 *s = (const Sint32*) src;
+        for (; i < n; i++){
+            d[i] = (Sint32) (((Sint64) s[i] * gain) >> 16);
+        }
+    }
+    else {
+/* 1.15 so it fits the signed 16-bit multiplies */
+        const Sint16 g15 = (Sint16) (gain >> 1);
+        const size_t n = len / sizeof(Sint16);
+        Sint16 *d = (Sint16*) dst;
+        const Sint16 *s = (const Sint16*) src;
+#if defined(HAVE_SSE2_INTRINSICS)
+        if (SDL_HasSSE2()){
+            const __m128i g = _mm_set1_epi16(g15);
+            for (; i + 8 <= n; i += 8){
+                __m128i v = _mm_loadu_si128((const __m128i*) &s[i]);
+                v = _mm_slli_epi16(_mm_mulhi_epi16(v, g), 1);
+                _mm_storeu_si128((__m128i*) &d[i], v);
+            }
+        }
+#elif defined(HAVE_NEON_INTRINSICS)
+        if (SDL_HasNEON()){
+            const int16x8_t g = vdupq_n_s16(g15);
+            for (; i + 8 <= n; i += 8){
+                vst1q_s16(&d[i], vqdmulhq_s16(vld1q_s16(&s[i]), g));
+            }
+        }
+#endif
+        for (; i < n; i++){
+            d[i] = (Sint16) (((Sint32) s[i] * g15) >> 15);
+        }
+    }
+}
+
+/*
+ * Move a mixed period into audp, honoring TARGET_COMMAND_ATTENUATE: full
+ * gain is a plain copy, muted ships silence without touching the samples.
+ */
+static void
+writeSamples(_THIS, Uint8 *dst, const Uint8 *src, size_t len, int gain)
+{
+    if (gain >= 65536){
+        if (dst != src){
+            memcpy(dst, src, len);
+        }
+    }
+    else if (gain <= 0){
+        SDL_memset(dst, this->spec.silence, len);
+    }
+    else {
+        scaleSamples(this->spec.format, dst, src, len, gain);
+    }
+}
+
 static void
 Arcan_PlayDevice(_THIS)
 {
@@ -118,37 +501,148 @@ Arcan_PlayDevice(_THIS)
 
     struct SDL_PrivateAudioData *adata = (struct SDL_PrivateAudioData *)
                                          this->hidden;
+    struct arcan_shmif_cont *out = adata->out;
 
     size_t left_in = adata->mixlen;
     uint8_t *cur = adata->mixbuf;
+    int gain;
 
     if (!cont){
         return;
     }
+    gain = SDL_AtomicGet(&cont->audio_gain);
 
-    /* the video driver gets to be the 'main thread', so it is only during
-     * signalling we need some protection against a resize- being called */
+    /* the callback already wrote into audp, just account for it */
+    if (adata->direct){
+        writeSamples(this, adata->direct, adata->direct, adata->mixlen, gain);
+        out->abufused += adata->mixlen;
+        if (out->abufused == out->abufsize){
+            signalBuffer(this, cont);
+        }
+        adata->direct = NULL;
+        releaseBuffer(this, cont);
+        applyCount(this, cont);
+        return;
+    }
+
+    /* the video driver gets to be the 'main thread', so it is only against a
+     * resize- of the primary segment that the copy needs protection, wait it
+     * out rather than blocking on the event processing */
+    while (!claimBuffer(this, cont)){
+        SDL_Delay(1);
+    }
 
-    SDL_LockMutex(cont->av_sync);
     while (left_in){
-        size_t ntc = (cont->mcont.abufsize - cont->mcont.abufused) < left_in ?
-                     (cont->mcont.abufsize - cont->mcont.abufused) : left_in;
+        size_t ntc = (out->abufsize - out->abufused) < left_in ?
+                     (out->abufsize - out->abufused) : left_in;
 
-        memcpy(&((uint8_t*)cont->mcont.audp)[cont->mcont.abufused], cur, ntc);
-        cont->mcont.abufused += ntc;
+        writeSamples(this, &((uint8_t*)out->audp)[out->abufused], cur, ntc, gain);
+        out->abufused += ntc;
         left_in -= ntc;
         cur += ntc;
-        if (cont->mcont.abufused == cont->mcont.abufsize){
-            arcan_shmif_signal(&cont->mcont, SHMIF_SIGAUD);
+        if (out->abufused == out->abufsize){
+            signalBuffer(this, cont);
         }
     }
-    SDL_UnlockMutex(cont->av_sync);
+    releaseBuffer(this, cont);
+    applyCount(this, cont);
 }
 
 static Uint8 *
 Arcan_GetDeviceBuf(_THIS)
 {
-    return (this->hidden->mixbuf);
+    struct SDL_PrivateAudioData *adata = this->hidden;
+    struct arcan_shmif_cont *out = adata->out;
+    Arcan_SDL_Meta *cont;
+    int gen;
+
+    if (!adata->use_direct){
+        return adata->mixbuf;
+    }
+
+    cont = (Arcan_SDL_Meta*) (arcan_shmif_primary(SHMIF_INPUT)->user);
+
+    /* announce that we are about to hold a pointer into audp, then back off
+     * if a resize got there first */
+    if (!claimBuffer(this, cont)){
+        return adata->mixbuf;
+    }
+
+    /* the buffer may have moved or changed size since last time, a period
+     * must never straddle two shmif buffers */
+    gen = SDL_AtomicGet(&cont->audio_gen);
+    if (gen != adata->gen){
+        adata->gen = gen;
+        adata->fits = out->audp && out->abufsize >= adata->mixlen &&
+                      (out->abufsize % adata->mixlen) == 0;
+    }
+
+    if (!adata->fits || out->abufsize - out->abufused < adata->mixlen){
+        releaseBuffer(this, cont);
+        return adata->mixbuf;
+    }
+
+    adata->direct = &((Uint8*)out->audp)[out->abufused];
+    return adata->direct;
+}
+
+/*
+ * What the server wrote into the buffer it flagged, our own abufused only
+ * tracks writes from this side.
+ */
+static size_t
+captureFill(struct arcan_shmif_cont *cap)
+{
+    int fill = cap->addr->abufused[cap->abufpos];
+    if (fill < 0){
+        return 0;
+    }
+    return (size_t) fill < cap->abufsize ? (size_t) fill : cap->abufsize;
+}
+
+static int
+Arcan_CaptureFromDevice(_THIS, void *buffer, int buflen)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+    struct arcan_shmif_cont *cap = &adata->seg;
+    size_t fill, ntc;
+
+    /* the server posts the audio semaphore when it has filled a buffer, the
+     * timeout is only there to notice shutdown or a dead segment */
+    while (!cap->addr->aready){
+        if (!cap->addr->dms || SDL_AtomicGet(&this->shutdown)){
+            return -1;
+        }
+        arcan_sem_timedwait(cap->asem, ARCAN_CAPTURE_WAIT);
+    }
+
+    fill = captureFill(cap);
+    ntc = fill > adata->cap_pos ? fill - adata->cap_pos : 0;
+    if (ntc > (size_t) buflen){
+        ntc = buflen;
+    }
+    SDL_memcpy(buffer, &((Uint8*)cap->audp)[adata->cap_pos], ntc);
+    adata->cap_pos += ntc;
+
+    /* whole buffer consumed, let the server refill it */
+    if (adata->cap_pos >= fill){
+        adata->cap_pos = 0;
+        arcan_shmif_signal(cap, SHMIF_SIGAUD | SHMIF_SIGBLK_NONE);
+    }
+
+    return (int) ntc;
+}
+
+static void
+Arcan_FlushCapture(_THIS)
+{
+    struct SDL_PrivateAudioData *adata = this->hidden;
+    struct arcan_shmif_cont *cap = &adata->seg;
+
+    if (cap->addr->aready){
+        arcan_shmif_signal(cap, SHMIF_SIGAUD | SHMIF_SIGBLK_NONE);
+    }
+    adata->cap_pos = 0;
 }
 
 static SDL_bool
@@ -159,16 +653,20 @@ Arcan_Init(SDL_AudioDriverImpl *impl)
     impl->PlayDevice = Arcan_PlayDevice;
     impl->GetDeviceBuf = Arcan_GetDeviceBuf;
     impl->CloseDevice = Arcan_CloseDevice;
-    impl->OnlyHasDefaultOutputDevice = 1;
+    impl->CaptureFromDevice = Arcan_CaptureFromDevice;
+    impl->FlushCapture = Arcan_FlushCapture;
+    impl->HasCaptureSupport = 1;
+    impl->OnlyHasDefaultCaptureDevice = 1;
     impl->AllowsArbitraryDeviceNames = 1;
 
     return 1;
 }
 
 /*
- * This is very similar to DSP audio since we can't directly mix into
- * the normal arcan buffer due to the risk of aliasing and video resizes
- * affecting buffer pointers.
+ * This is very similar to DSP audio, by default we don't mix directly into
+ * the normal arcan buffer due to the risk of aliasing. Both the copy and
+ * SDL_ARCAN_AUDIO_DIRECT rely on the busy/generation handshake with the
+ * resize paths instead of a lock shared with the event loop.
  */
 AudioBootStrap ARCANAUDIO_bootstrap = {
     "arcan", "Arcan audio driver", Arcan_Init, 0
@@ -23,6 +23,8 @@
 #ifndef _SDL_arcanaudio_h
 #define _SDL_arcanaudio_h
 
+#include <arcan_shmif.h>
+
 #include "../SDL_sysaudio.h"
 
 /* Hidden "this" pointer for the audio functions */
@@ -32,6 +34,37 @@ struct SDL_PrivateAudioData
 {
     Uint8 *mixbuf;
     int mixlen;
+
+    /* SDL_ARCAN_AUDIO_DIRECT: [direct] is set between GetDeviceBuf and
+     * PlayDevice when the callback mixes straight into audp, [fits] is
+     * re-evaluated whenever the segment generation changes */
+    SDL_bool use_direct;
+    SDL_bool fits;
+    Uint8 *direct;
+    int gen;
+
+    /* performance counter at the last SHMIF_SIGAUD, for underrun detection */
+    Uint64 last_signal;
+
+    /* apts comes from the sample clock, frames handed to the server since
+     * [apts_base] (SDL_GetTicks64, same clock as the video vpts) */
+    Uint64 apts_base;
+    Uint64 frames_out;
+
+    /* SDL_ARCAN_AUDIO_LATENCY: the buffer count we asked for, its bounds,
+     * signals since the last underrun and a pending change of count */
+    SDL_bool adaptive;
+    int abuf_cnt, abuf_min, abuf_max;
+    int calm;
+    int want_cnt;
+
+    /* [out] is the segment playback writes to, either the shared primary or
+     * [seg]. Capture devices and any playback device beyond the first get
+     * their own subsegment in [seg], [cap_pos] is how far into the current
+     * server buffer capture has read */
+    struct arcan_shmif_cont *out;
+    struct arcan_shmif_cont seg;
+    size_t cap_pos;
 };
 
 #endif /* _SDL_arcanaudio_h */
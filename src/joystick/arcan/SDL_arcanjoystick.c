@@ -0,0 +1,475 @@
+/*
+  Simple DirectMedia Layer
+  Copyright (C) 1997-2024 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+#include "../../SDL_internal.h"
+
+#ifdef SDL_JOYSTICK_ARCAN
+
+/* This is the arcan implementation of the SDL joystick API, game devices are
+   not opened by the client but forwarded by the server as EVENT_IO samples
+   on the primary segment, so the arcan video driver has to be the one that
+   pumps them in here. */
+
+#include "SDL_events.h"
+#include "SDL_arcanjoystick_c.h"
+#include "../SDL_sysjoystick.h"
+#include "../SDL_joystick_c.h"
+
+/* Upper bounds on the subids kept per device, how many a device actually has
+   is only known from the samples it has sent so far. */
+#define ARCAN_JOYSTICK_AXES    8
+#define ARCAN_JOYSTICK_BUTTONS 32
+
+typedef struct joystick_hwdata
+{
+    Uint16 devid;
+    char *name;
+    SDL_JoystickGUID guid;
+    Sint16 axes[ARCAN_JOYSTICK_AXES];
+    Uint8 buttons[ARCAN_JOYSTICK_BUTTONS];
+    int naxes;
+    int nbuttons;
+    SDL_JoystickID instance_id;
+    SDL_Joystick *joystick;
+
+    struct joystick_hwdata *next;
+} joystick_hwdata;
+
+static joystick_hwdata *g_ArcanJoys SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
+
+static joystick_hwdata *ARCAN_HWDataForIndex(int device_index)
+{
+    joystick_hwdata *ajoy;
+
+    SDL_AssertJoysticksLocked();
+
+    for (ajoy = g_ArcanJoys; ajoy; ajoy = ajoy->next) {
+        if (device_index == 0) {
+            break;
+        }
+        --device_index;
+    }
+    return ajoy;
+}
+
+static joystick_hwdata *ARCAN_HWDataForDevID(Uint16 devid)
+{
+    joystick_hwdata *ajoy;
+
+    SDL_AssertJoysticksLocked();
+
+    for (ajoy = g_ArcanJoys; ajoy; ajoy = ajoy->next) {
+        if (ajoy->devid == devid) {
+            break;
+        }
+    }
+    return ajoy;
+}
+
+static void ARCAN_FreeHWData(joystick_hwdata *hwdata)
+{
+    joystick_hwdata *cur;
+    joystick_hwdata *prev = NULL;
+
+    SDL_AssertJoysticksLocked();
+
+    for (cur = g_ArcanJoys; cur; prev = cur, cur = cur->next) {
+        if (hwdata == cur) {
+            if (prev) {
+                prev->next = cur->next;
+            } else {
+                g_ArcanJoys = cur->next;
+            }
+            break;
+        }
+    }
+
+    if (hwdata->joystick) {
+        hwdata->joystick->hwdata = NULL;
+        hwdata->joystick = NULL;
+    }
+    SDL_free(hwdata->name);
+    SDL_free(hwdata);
+}
+
+/* The server knows the USB identity of the device but the io event has no
+   field for it, so a label on the form "vvvv:pppp[:name]" is taken as that
+   identity. That is what lets the GUID line up with gamecontrollerdb, any
+   other label only gets a name based GUID. */
+static joystick_hwdata *ARCAN_AddHWData(Uint16 devid, const char *label)
+{
+    joystick_hwdata *hwdata;
+    joystick_hwdata *last;
+    unsigned int vendor = 0, product = 0;
+    const char *product_name = NULL;
+    char fallback[32];
+    char ident[32];
+
+    SDL_AssertJoysticksLocked();
+
+    hwdata = (joystick_hwdata *)SDL_calloc(1, sizeof(*hwdata));
+    if (!hwdata) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    ident[0] = '\0';
+    if (label) {
+        SDL_strlcpy(ident, label, sizeof(ident));
+    }
+
+    if (SDL_sscanf(ident, "%4x:%4x", &vendor, &product) == 2) {
+        product_name = SDL_strchr(ident, ':');
+        product_name = SDL_strchr(product_name + 1, ':');
+        product_name = product_name ? product_name + 1 : NULL;
+        hwdata->name = SDL_CreateJoystickName((Uint16)vendor, (Uint16)product, NULL, product_name);
+        hwdata->guid = SDL_CreateJoystickGUID(SDL_HARDWARE_BUS_USB, (Uint16)vendor, (Uint16)product, 0, NULL, product_name, 0, 0);
+    } else {
+        if (!*ident) {
+            SDL_snprintf(fallback, sizeof(fallback), "Arcan Game Device %d", (int)devid);
+            product_name = fallback;
+        } else {
+            product_name = ident;
+        }
+        hwdata->name = SDL_strdup(product_name);
+        hwdata->guid = SDL_CreateJoystickGUIDForName(product_name);
+    }
+
+    if (!hwdata->name) {
+        SDL_free(hwdata);
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    hwdata->devid = devid;
+    hwdata->instance_id = SDL_GetNextJoystickInstanceID();
+
+    /* Keep arrival order so device indices stay stable */
+    if (g_ArcanJoys) {
+        for (last = g_ArcanJoys; last->next; last = last->next) {
+        }
+        last->next = hwdata;
+    } else {
+        g_ArcanJoys = hwdata;
+    }
+
+    SDL_PrivateJoystickAdded(hwdata->instance_id);
+    return hwdata;
+}
+
+/* Samples can arrive from devices that were plugged in before the joystick
+   subsystem was up, or whose status event we never got, those get added on
+   first use instead. */
+static joystick_hwdata *ARCAN_HWDataForInput(Uint16 devid, const char *label)
+{
+    joystick_hwdata *hwdata;
+
+    if (!SDL_JoysticksInitialized()) {
+        return NULL;
+    }
+
+    hwdata = ARCAN_HWDataForDevID(devid);
+    if (!hwdata) {
+        hwdata = ARCAN_AddHWData(devid, label);
+    }
+    return hwdata;
+}
+
+void ARCAN_JoystickAdded(Uint16 devid, const char *label)
+{
+    SDL_LockJoysticks();
+    ARCAN_HWDataForInput(devid, label);
+    SDL_UnlockJoysticks();
+}
+
+void ARCAN_JoystickRemoved(Uint16 devid)
+{
+    joystick_hwdata *hwdata;
+    SDL_JoystickID instance_id;
+
+    SDL_LockJoysticks();
+    if (SDL_JoysticksInitialized()) {
+        hwdata = ARCAN_HWDataForDevID(devid);
+        if (hwdata) {
+            instance_id = hwdata->instance_id;
+            ARCAN_FreeHWData(hwdata);
+            SDL_PrivateJoystickRemoved(instance_id);
+        }
+    }
+    SDL_UnlockJoysticks();
+}
+
+/* The layout of an opened joystick can't change, so a subid beyond it
+   re-announces the device under a new instance that the application can
+   open again with everything seen so far. */
+static void ARCAN_GrowLayout(joystick_hwdata *hwdata, int naxes, int nbuttons)
+{
+    SDL_Joystick *joystick = hwdata->joystick;
+    SDL_JoystickID instance_id = hwdata->instance_id;
+
+    hwdata->naxes = SDL_max(hwdata->naxes, naxes);
+    hwdata->nbuttons = SDL_max(hwdata->nbuttons, nbuttons);
+
+    if (!joystick ||
+        (hwdata->naxes <= joystick->naxes && hwdata->nbuttons <= joystick->nbuttons)) {
+        return;
+    }
+
+    joystick->hwdata = NULL;
+    hwdata->joystick = NULL;
+    hwdata->instance_id = SDL_GetNextJoystickInstanceID();
+    SDL_PrivateJoystickRemoved(instance_id);
+    SDL_PrivateJoystickAdded(hwdata->instance_id);
+}
+
+void ARCAN_JoystickAxis(Uint16 devid, const char *label, int axis, Sint16 value)
+{
+    joystick_hwdata *hwdata;
+
+    if (axis < 0 || axis >= ARCAN_JOYSTICK_AXES) {
+        return;
+    }
+
+    SDL_LockJoysticks();
+    hwdata = ARCAN_HWDataForInput(devid, label);
+    if (hwdata) {
+        hwdata->axes[axis] = value;
+        ARCAN_GrowLayout(hwdata, axis + 1, 0);
+    }
+    SDL_UnlockJoysticks();
+}
+
+void ARCAN_JoystickButton(Uint16 devid, const char *label, int button, SDL_bool pressed)
+{
+    joystick_hwdata *hwdata;
+
+    if (button < 0 || button >= ARCAN_JOYSTICK_BUTTONS) {
+        return;
+    }
+
+    SDL_LockJoysticks();
+    hwdata = ARCAN_HWDataForInput(devid, label);
+    if (hwdata) {
+        hwdata->buttons[button] = pressed ? SDL_PRESSED : SDL_RELEASED;
+        ARCAN_GrowLayout(hwdata, 0, button + 1);
+    }
+    SDL_UnlockJoysticks();
+}
+
+static int ARCAN_JoystickInit(void)
+{
+    return 0;
+}
+
+static int ARCAN_JoystickGetCount(void)
+{
+    joystick_hwdata *cur;
+    int count = 0;
+
+    SDL_AssertJoysticksLocked();
+
+    for (cur = g_ArcanJoys; cur; cur = cur->next) {
+        ++count;
+    }
+    return count;
+}
+
+static void ARCAN_JoystickDetect(void)
+{
+}
+
+static const char *ARCAN_JoystickGetDeviceName(int device_index)
+{
+    joystick_hwdata *hwdata = ARCAN_HWDataForIndex(device_index);
+    if (!hwdata) {
+        return NULL;
+    }
+    return hwdata->name;
+}
+
+static const char *ARCAN_JoystickGetDevicePath(int device_index)
+{
+    return NULL;
+}
+
+static int ARCAN_JoystickGetDeviceSteamVirtualGamepadSlot(int device_index)
+{
+    return -1;
+}
+
+static int ARCAN_JoystickGetDevicePlayerIndex(int device_index)
+{
+    return -1;
+}
+
+static void ARCAN_JoystickSetDevicePlayerIndex(int device_index, int player_index)
+{
+}
+
+static SDL_JoystickGUID ARCAN_JoystickGetDeviceGUID(int device_index)
+{
+    joystick_hwdata *hwdata = ARCAN_HWDataForIndex(device_index);
+    if (!hwdata) {
+        SDL_JoystickGUID guid;
+        SDL_zero(guid);
+        return guid;
+    }
+    return hwdata->guid;
+}
+
+static SDL_JoystickID ARCAN_JoystickGetDeviceInstanceID(int device_index)
+{
+    joystick_hwdata *hwdata = ARCAN_HWDataForIndex(device_index);
+    if (!hwdata) {
+        return -1;
+    }
+    return hwdata->instance_id;
+}
+
+static int ARCAN_JoystickOpen(SDL_Joystick *joystick, int device_index)
+{
+    joystick_hwdata *hwdata;
+
+    SDL_AssertJoysticksLocked();
+
+    hwdata = ARCAN_HWDataForIndex(device_index);
+    if (!hwdata) {
+        return SDL_SetError("No such device");
+    }
+    joystick->instance_id = hwdata->instance_id;
+    joystick->hwdata = hwdata;
+
+    /* The layout is fixed once opened, so a device that hasn't sent anything
+       yet gets the full range rather than none at all. */
+    if (hwdata->naxes || hwdata->nbuttons) {
+        joystick->naxes = hwdata->naxes;
+        joystick->nbuttons = hwdata->nbuttons;
+    } else {
+        joystick->naxes = ARCAN_JOYSTICK_AXES;
+        joystick->nbuttons = ARCAN_JOYSTICK_BUTTONS;
+    }
+    joystick->nhats = 0;
+    hwdata->joystick = joystick;
+    return 0;
+}
+
+static int ARCAN_JoystickRumble(SDL_Joystick *joystick, Uint16 low_frequency_rumble, Uint16 high_frequency_rumble)
+{
+    return SDL_Unsupported();
+}
+
+static int ARCAN_JoystickRumbleTriggers(SDL_Joystick *joystick, Uint16 left_rumble, Uint16 right_rumble)
+{
+    return SDL_Unsupported();
+}
+
+static Uint32 ARCAN_JoystickGetCapabilities(SDL_Joystick *joystick)
+{
+    return 0;
+}
+
+static int ARCAN_JoystickSetLED(SDL_Joystick *joystick, Uint8 red, Uint8 green, Uint8 blue)
+{
+    return SDL_Unsupported();
+}
+
+static int ARCAN_JoystickSendEffect(SDL_Joystick *joystick, const void *data, int size)
+{
+    return SDL_Unsupported();
+}
+
+static int ARCAN_JoystickSetSensorsEnabled(SDL_Joystick *joystick, SDL_bool enabled)
+{
+    return SDL_Unsupported();
+}
+
+static void ARCAN_JoystickUpdate(SDL_Joystick *joystick)
+{
+    joystick_hwdata *hwdata;
+    int i;
+
+    SDL_AssertJoysticksLocked();
+
+    if (!joystick || !joystick->hwdata) {
+        return;
+    }
+
+    hwdata = (joystick_hwdata *)joystick->hwdata;
+
+    for (i = 0; i < joystick->naxes; ++i) {
+        SDL_PrivateJoystickAxis(joystick, i, hwdata->axes[i]);
+    }
+    for (i = 0; i < joystick->nbuttons; ++i) {
+        SDL_PrivateJoystickButton(joystick, i, hwdata->buttons[i]);
+    }
+}
+
+static void ARCAN_JoystickClose(SDL_Joystick *joystick)
+{
+    SDL_AssertJoysticksLocked();
+
+    if (joystick->hwdata) {
+        joystick_hwdata *hwdata = joystick->hwdata;
+        hwdata->joystick = NULL;
+        joystick->hwdata = NULL;
+    }
+}
+
+static void ARCAN_JoystickQuit(void)
+{
+    SDL_AssertJoysticksLocked();
+
+    while (g_ArcanJoys) {
+        ARCAN_FreeHWData(g_ArcanJoys);
+    }
+}
+
+static SDL_bool ARCAN_JoystickGetGamepadMapping(int device_index, SDL_GamepadMapping *out)
+{
+    return SDL_FALSE;
+}
+
+SDL_JoystickDriver SDL_ARCAN_JoystickDriver = {
+    ARCAN_JoystickInit,
+    ARCAN_JoystickGetCount,
+    ARCAN_JoystickDetect,
+    ARCAN_JoystickGetDeviceName,
+    ARCAN_JoystickGetDevicePath,
+    ARCAN_JoystickGetDeviceSteamVirtualGamepadSlot,
+    ARCAN_JoystickGetDevicePlayerIndex,
+    ARCAN_JoystickSetDevicePlayerIndex,
+    ARCAN_JoystickGetDeviceGUID,
+    ARCAN_JoystickGetDeviceInstanceID,
+    ARCAN_JoystickOpen,
+    ARCAN_JoystickRumble,
+    ARCAN_JoystickRumbleTriggers,
+    ARCAN_JoystickGetCapabilities,
+    ARCAN_JoystickSetLED,
+    ARCAN_JoystickSendEffect,
+    ARCAN_JoystickSetSensorsEnabled,
+    ARCAN_JoystickUpdate,
+    ARCAN_JoystickClose,
+    ARCAN_JoystickQuit,
+    ARCAN_JoystickGetGamepadMapping
+};
+
+#endif /* SDL_JOYSTICK_ARCAN */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,41 @@
+/*
+  Simple DirectMedia Layer
+  Copyright (C) 1997-2024 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+#include "../../SDL_internal.h"
+
+#ifndef SDL_ARCANJOYSTICK_C_H
+#define SDL_ARCANJOYSTICK_C_H
+
+#ifdef SDL_JOYSTICK_ARCAN
+
+#include "SDL_joystick.h"
+
+/* Game devices are routed through the arcan video driver event pump,
+   these feed it into the joystick driver and take the joystick lock. */
+void ARCAN_JoystickAdded(Uint16 devid, const char *label);
+void ARCAN_JoystickRemoved(Uint16 devid);
+void ARCAN_JoystickAxis(Uint16 devid, const char *label, int axis, Sint16 value);
+void ARCAN_JoystickButton(Uint16 devid, const char *label, int button, SDL_bool pressed);
+
+#endif /* SDL_JOYSTICK_ARCAN */
+
+#endif /* SDL_ARCANJOYSTICK_C_H */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -297,6 +297,7 @@ struct SDL_RenderDriver
 };
 
 /* Not all of these are available in a given build. Use #ifdefs, etc. */
+extern SDL_RenderDriver ARCAN_RenderDriver;
 extern SDL_RenderDriver D3D_RenderDriver;
 extern SDL_RenderDriver D3D11_RenderDriver;
 extern SDL_RenderDriver D3D12_RenderDriver;
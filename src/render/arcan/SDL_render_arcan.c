@@ -0,0 +1,286 @@
+/*
+  Simple DirectMedia Layer
+  Copyright (C) 1997-2024 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+#include "../../SDL_internal.h"
+
+#if SDL_VIDEO_RENDER_ARCAN
+
+/* The arcan renderer is the software renderer pointed straight at the window
+ * framebuffer, which for the arcan video driver is vidp of the segment in the
+ * server native format. On top of that it keeps track of what each frame
+ * touched so that present only signals those regions. */
+
+#include "../SDL_sysrender.h"
+#include "../software/SDL_render_sw_c.h"
+#include "../../video/SDL_sysvideo.h"
+#include "../../video/arcan/SDL_arcanvideo.h"
+
+/* the software implementations that get wrapped, same for every renderer */
+static int (*SW_RunCommandQueue)(SDL_Renderer *, SDL_RenderCommand *, void *, size_t);
+static void (*SW_WindowEvent)(SDL_Renderer *, const SDL_WindowEvent *);
+
+static Arcan_WindowData *ARCAN_GetWindowData(SDL_Renderer *renderer)
+{
+    SDL_Window *window = renderer->window;
+
+    if (!window || !window->driverdata) {
+        return NULL;
+    }
+    return (Arcan_WindowData *)window->driverdata;
+}
+
+static void ARCAN_AddDirty(Arcan_WindowData *data, const SDL_Rect *bounds, const SDL_Rect *rect)
+{
+    SDL_Rect r;
+
+    if (data->render_full || !SDL_IntersectRect(rect, bounds, &r)) {
+        return;
+    }
+
+    /* past the limit just grow the last one, the framebuffer merges anyway */
+    if (data->render_dirty_n == ARCAN_RENDER_DIRTY) {
+        SDL_UnionRect(&data->render_dirty[ARCAN_RENDER_DIRTY - 1], &r,
+                      &data->render_dirty[ARCAN_RENDER_DIRTY - 1]);
+    } else {
+        data->render_dirty[data->render_dirty_n++] = r;
+    }
+}
+
+static void ARCAN_AddPoints(Arcan_WindowData *data, const SDL_Rect *bounds,
+                            const SDL_Rect *viewport, const SDL_Point *points, int count)
+{
+    SDL_Rect r;
+    int x1, y1, x2, y2;
+    int i;
+
+    if (count <= 0) {
+        return;
+    }
+
+    x1 = x2 = points[0].x;
+    y1 = y2 = points[0].y;
+    for (i = 1; i < count; i++) {
+        x1 = SDL_min(x1, points[i].x);
+        y1 = SDL_min(y1, points[i].y);
+        x2 = SDL_max(x2, points[i].x);
+        y2 = SDL_max(y2, points[i].y);
+    }
+
+    r.x = x1 + viewport->x;
+    r.y = y1 + viewport->y;
+    r.w = x2 - x1 + 1;
+    r.h = y2 - y1 + 1;
+    ARCAN_AddDirty(data, bounds, &r);
+}
+
+/*
+ * Walks the queue ahead of the software renderer, which offsets the vertices
+ * in place, and records the screen rectangle of each draw clipped to the
+ * viewport and clip rectangle. Rotated copies and geometry are only bounded
+ * by the clip region.
+ */
+static void ARCAN_TrackCommands(SDL_Renderer *renderer, Arcan_WindowData *data,
+                                SDL_RenderCommand *cmd, void *vertices)
+{
+    SDL_Rect full = { 0, 0, data->con->w, data->con->h };
+    SDL_Rect viewport = full;
+    SDL_Rect bounds = full;
+    const SDL_Rect *cliprect = NULL;
+
+    while (cmd) {
+        switch (cmd->command) {
+        case SDL_RENDERCMD_SETVIEWPORT:
+        case SDL_RENDERCMD_SETCLIPRECT:
+            if (cmd->command == SDL_RENDERCMD_SETVIEWPORT) {
+                viewport = cmd->data.viewport.rect;
+            } else {
+                cliprect = cmd->data.cliprect.enabled ? &cmd->data.cliprect.rect : NULL;
+            }
+            SDL_IntersectRect(&viewport, &full, &bounds);
+            if (cliprect) {
+                SDL_Rect clip = *cliprect;
+                clip.x += viewport.x;
+                clip.y += viewport.y;
+                SDL_IntersectRect(&clip, &bounds, &bounds);
+            }
+            break;
+
+        case SDL_RENDERCMD_CLEAR:
+            data->render_full = true;
+            break;
+
+        case SDL_RENDERCMD_DRAW_POINTS:
+        case SDL_RENDERCMD_DRAW_LINES:
+            ARCAN_AddPoints(data, &bounds, &viewport,
+                            (const SDL_Point *)((Uint8 *)vertices + cmd->data.draw.first),
+                            (int)cmd->data.draw.count);
+            break;
+
+        case SDL_RENDERCMD_FILL_RECTS:
+        {
+            const SDL_Rect *rects = (const SDL_Rect *)((Uint8 *)vertices + cmd->data.draw.first);
+            size_t i;
+            for (i = 0; i < cmd->data.draw.count; i++) {
+                SDL_Rect r = rects[i];
+                r.x += viewport.x;
+                r.y += viewport.y;
+                ARCAN_AddDirty(data, &bounds, &r);
+            }
+            break;
+        }
+
+        case SDL_RENDERCMD_COPY:
+        {
+            /* source and destination rectangle, see SW_QueueCopy */
+            SDL_Rect r = ((const SDL_Rect *)((Uint8 *)vertices + cmd->data.draw.first))[1];
+            r.x += viewport.x;
+            r.y += viewport.y;
+            ARCAN_AddDirty(data, &bounds, &r);
+            break;
+        }
+
+        case SDL_RENDERCMD_COPY_EX:
+        case SDL_RENDERCMD_GEOMETRY:
+            ARCAN_AddDirty(data, &bounds, &bounds);
+            break;
+
+        default:
+            break;
+        }
+
+        cmd = cmd->next;
+    }
+}
+
+static int ARCAN_RunCommandQueue(SDL_Renderer *renderer, SDL_RenderCommand *cmd, void *vertices, size_t vertsize)
+{
+    Arcan_WindowData *data = ARCAN_GetWindowData(renderer);
+
+    /* drawing into a target texture leaves the window alone */
+    if (data && data->con && !renderer->target) {
+        ARCAN_TrackCommands(renderer, data, cmd, vertices);
+    }
+    return SW_RunCommandQueue(renderer, cmd, vertices, vertsize);
+}
+
+static void ARCAN_WindowEvent(SDL_Renderer *renderer, const SDL_WindowEvent *event)
+{
+    Arcan_WindowData *data = ARCAN_GetWindowData(renderer);
+
+    if (data && event->event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+        data->render_full = true;
+    }
+    SW_WindowEvent(renderer, event);
+}
+
+static int ARCAN_RenderPresent(SDL_Renderer *renderer)
+{
+    SDL_Window *window = renderer->window;
+    Arcan_WindowData *data = ARCAN_GetWindowData(renderer);
+    int retval;
+
+    if (!window || !data) {
+        return -1;
+    }
+
+    /* an empty update still goes through for frame pacing */
+    if (data->render_full) {
+        retval = SDL_UpdateWindowSurface(window);
+    } else {
+        retval = SDL_UpdateWindowSurfaceRects(window, data->render_dirty, data->render_dirty_n);
+    }
+
+    data->render_dirty_n = 0;
+    data->render_full = false;
+    return retval;
+}
+
+static int ARCAN_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, Uint32 flags)
+{
+    static SDL_bool creating = SDL_FALSE;
+    const char *driver = SDL_GetCurrentVideoDriver();
+    Arcan_WindowData *data;
+    SDL_Surface *surface;
+    int retval;
+
+    if (!driver || SDL_strcasecmp(driver, "arcan") != 0) {
+        return SDL_SetError("The arcan renderer needs the arcan video driver");
+    }
+    if (window->flags & SDL_WINDOW_OPENGL) {
+        return SDL_SetError("The arcan renderer can't draw into an OpenGL window");
+    }
+
+    /* the window surface might try a texture framebuffer, which tries us */
+    if (creating) {
+        return SDL_SetError("The arcan renderer can't back a texture framebuffer");
+    }
+
+    creating = SDL_TRUE;
+    surface = SDL_GetWindowSurface(window);
+    creating = SDL_FALSE;
+
+    if (!surface) {
+        return -1;
+    }
+
+    retval = SW_CreateRendererForSurface(renderer, surface);
+    if (retval < 0) {
+        return retval;
+    }
+
+    SW_RunCommandQueue = renderer->RunCommandQueue;
+    SW_WindowEvent = renderer->WindowEvent;
+
+    renderer->RunCommandQueue = ARCAN_RunCommandQueue;
+    renderer->WindowEvent = ARCAN_WindowEvent;
+    renderer->RenderPresent = ARCAN_RenderPresent;
+    renderer->info = ARCAN_RenderDriver.info;
+
+    /* whatever was in the buffer before is not ours */
+    data = (Arcan_WindowData *)window->driverdata;
+    data->render_dirty_n = 0;
+    data->render_full = true;
+
+    return 0;
+}
+
+SDL_RenderDriver ARCAN_RenderDriver = {
+    ARCAN_CreateRenderer,
+    {
+     "arcan",
+     SDL_RENDERER_SOFTWARE | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE,
+     8,
+     {
+      SDL_PIXELFORMAT_ARGB8888,
+      SDL_PIXELFORMAT_ABGR8888,
+      SDL_PIXELFORMAT_RGBA8888,
+      SDL_PIXELFORMAT_BGRA8888,
+      SDL_PIXELFORMAT_RGB888,
+      SDL_PIXELFORMAT_BGR888,
+      SDL_PIXELFORMAT_RGB565,
+      SDL_PIXELFORMAT_RGB555
+     },
+     0,
+     0}
+};
+
+#endif /* SDL_VIDEO_RENDER_ARCAN */
+
+/* vi: set ts=4 sw=4 expandtab: */
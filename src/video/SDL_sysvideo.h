@@ -156,6 +156,8 @@ typedef enum
     VIDEO_DEVICE_QUIRK_DISABLE_DISPLAY_MODE_SWITCHING = 0x01,
     VIDEO_DEVICE_QUIRK_DISABLE_UNSET_FULLSCREEN_ON_MINIMIZE = 0x02,
     VIDEO_DEVICE_QUIRK_FULLSCREEN_ONLY = 0x04,
+    VIDEO_DEVICE_QUIRK_FULLSCREEN_SENDS_RESIZE = 0x08,
+    VIDEO_DEVICE_QUIRK_FRAMEBUFFER_IS_SHARED = 0x10,
 } DeviceQuirkFlags;
 
 struct SDL_VideoDevice
@@ -198,6 +198,16 @@ static SDL_bool IsFullscreenOnly(_THIS)
     return !!(_this->quirk_flags & VIDEO_DEVICE_QUIRK_FULLSCREEN_ONLY);
 }
 
+static SDL_bool FullscreenSendsResize(_THIS)
+{
+    return !!(_this->quirk_flags & VIDEO_DEVICE_QUIRK_FULLSCREEN_SENDS_RESIZE);
+}
+
+static SDL_bool FramebufferIsShared(_THIS)
+{
+    return !!(_this->quirk_flags & VIDEO_DEVICE_QUIRK_FRAMEBUFFER_IS_SHARED);
+}
+
 /* Support for framebuffer emulation using an accelerated renderer */
 
 #define SDL_WINDOWTEXTUREDATA "_SDL_WindowTextureData"
@@ -1522,7 +1532,8 @@ static int SDL_UpdateFullscreenMode(SDL_Window *window, SDL_bool fullscreen)
 
                 /* Generate a mode change event here */
                 if (resized) {
-                    if (SDL_strcmp(_this->name, "Android") != 0 && SDL_strcmp(_this->name, "windows") != 0) {
+                    if (SDL_strcmp(_this->name, "Android") != 0 && SDL_strcmp(_this->name, "windows") != 0 &&
+                        !FullscreenSendsResize(_this)) {
                         /* Android may not resize the window to exactly what our fullscreen mode is, especially on
                          * windowed Android environments like the Chromebook or Samsung DeX.  Given this, we shouldn't
                          * use fullscreen_mode.w and fullscreen_mode.h, but rather get our current native size.  As such,
@@ -1532,6 +1543,8 @@ static int SDL_UpdateFullscreenMode(SDL_Window *window, SDL_bool fullscreen)
                         /* This is also unnecessary on Win32 (WIN_SetWindowFullscreen calls SetWindowPos,
                          * WM_WINDOWPOSCHANGED will send SDL_WINDOWEVENT_RESIZED). Also, on Windows with DPI scaling enabled,
                          * we're keeping modes in pixels, but window sizes in dpi-scaled points, so this would be a unit mismatch.
+                         * Drivers with VIDEO_DEVICE_QUIRK_FULLSCREEN_SENDS_RESIZE may keep the window at its own
+                         * size and leave the scaling to the compositor, so they send the event themselves.
                          */
                         SDL_SendWindowEvent(other, SDL_WINDOWEVENT_RESIZED,
                                             fullscreen_mode.w, fullscreen_mode.h);
@@ -2698,6 +2711,10 @@ static SDL_bool ShouldAttemptTextureFramebuffer(void)
 #if defined(__EMSCRIPTEN__)
         attempt_texture_framebuffer = SDL_FALSE;
 #endif
+        /* the window surface already is the memory the compositor reads from */
+        if (_this->CreateWindowFramebuffer && FramebufferIsShared(_this)) {
+            attempt_texture_framebuffer = SDL_FALSE;
+        }
     }
     return attempt_texture_framebuffer;
 }
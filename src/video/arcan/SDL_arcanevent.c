@@ -27,17 +27,59 @@
 #include "../../events/SDL_events_c.h"
 #include "../../events/SDL_keyboard_c.h"
 #include "../../events/SDL_touch_c.h"
+#include "../../events/SDL_clipboardevents_c.h"
 #include "../../events/SDL_events_c.h"
 
 #include "SDL_arcanwindow.h"
 #include "SDL_video.h"
 #include "SDL_timer.h"
+#include "SDL_hints.h"
 #include "SDL_arcanevent.h"
+#include "SDL_arcanmouse.h"
+#include "SDL_arcanframebuffer.h"
+#include "SDL_arcanrecord.h"
+
+#ifdef SDL_JOYSTICK_ARCAN
+#include "../../joystick/arcan/SDL_arcanjoystick_c.h"
+#endif
 
 #ifdef __LINUX__
 #include "../../events/scancodes_linux.h"
 #endif
 
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* longest a paced present waits for a step before the window is treated as
+ * unpaced until the server steps it again, in ms */
+#define ARCAN_STEP_TIMEOUT 100
+
+/* most clipboard bytes moved over a bchunk descriptor per pump and direction */
+#define ARCAN_CLIP_BUDGET (256 * 1024)
+
+/* motion is deferred until the queue of a segment has been drained, or until
+ * something else that has to be ordered after it (buttons) arrives, relative
+ * mode gets the deltas summed over that span and not the clamped position */
+static void flush_mouse(SDL_Window *wnd, Arcan_SDL_Meta *meta)
+{
+    if (!meta->dirty_mouse){
+        return;
+    }
+
+    if (SDL_GetMouse()->relative_mode){
+        if (meta->dx || meta->dy){
+            SDL_SendMouseMotion(wnd, 0, 1, meta->dx, meta->dy);
+        }
+    }
+    else {
+        SDL_SendMouseMotion(wnd, 0, 0, meta->mx, meta->my);
+    }
+
+    meta->dx = meta->dy = 0;
+    meta->dirty_mouse = false;
+}
+
 static inline void process_mouse(struct arcan_shmif_cont *prim,
                                  struct arcan_shmif_cont *cur,
                                  SDL_Window *wnd,
@@ -45,10 +87,21 @@ static inline void process_mouse(struct arcan_shmif_cont *prim,
                                  arcan_event *ev)
 {
     if (ev->io.datatype == EVENT_IDATATYPE_ANALOG){
-        arcan_shmif_mousestate(prim, meta->mstate, ev, &meta->mx, &meta->my);
-        SDL_SendMouseMotion(wnd, 0, meta->mrel, meta->mx, meta->my);
+        int dx, dy;
+        if (arcan_shmif_mousestate(prim, meta->mstate, ev, &meta->mx, &meta->my)){
+            meta->dirty_mouse = true;
+        }
+        if (arcan_shmif_mousestate(prim, meta->mstate_rel, ev, &dx, &dy)){
+            meta->dx += dx;
+            meta->dy += dy;
+            meta->dirty_mouse = true;
+        }
+        if (!meta->coalesce_mouse){
+            flush_mouse(wnd, meta);
+        }
     }
     else if (ev->io.datatype == EVENT_IDATATYPE_DIGITAL){
+        flush_mouse(wnd, meta);
         switch(ev->io.subid){
         case MBTN_LEFT_IND:
             SDL_SendMouseButton(wnd, ev->io.devid,
@@ -111,16 +164,147 @@ static inline void process_gamedev(struct arcan_shmif_cont *prim,
                                    Arcan_SDL_Meta *meta,
                                    arcan_ioevent ev)
 {
-/* game device */
+#ifdef SDL_JOYSTICK_ARCAN
+    char label[sizeof(ev.label) + 1];
+
+/* the label is only terminated if it is shorter than the field */
+    SDL_memcpy(label, ev.label, sizeof(ev.label));
+    label[sizeof(ev.label)] = '\0';
+
+    if (ev.devkind != EVENT_IDEVKIND_GAMEDEV){
+        return;
+    }
+
+    if (ev.datatype == EVENT_IDATATYPE_ANALOG){
+        if (ev.input.analog.nvalues > 0){
+            ARCAN_JoystickAxis(ev.devid, label, ev.subid, ev.input.analog.axisval[0]);
+        }
+    }
+    else if (ev.datatype == EVENT_IDATATYPE_DIGITAL){
+        ARCAN_JoystickButton(ev.devid, label, ev.subid,
+                             ev.input.digital.active ? SDL_TRUE : SDL_FALSE);
+    }
+#endif
+}
+
+static void flush_finger(SDL_Window *wnd, Arcan_SDL_Meta *meta, int i)
+{
+    if (meta->fingers[i].dirty){
+        SDL_SendTouchMotion(meta->fingers[i].touch, meta->fingers[i].finger, wnd,
+                            meta->fingers[i].x, meta->fingers[i].y,
+                            meta->fingers[i].pressure);
+        meta->fingers[i].dirty = false;
+    }
 }
 
+static void flush_touch(SDL_Window *wnd, Arcan_SDL_Meta *meta)
+{
+    for (int i = 0; i < ARCAN_MAX_FINGERS; i++){
+        flush_finger(wnd, meta, i);
+    }
+}
+
+/*
+ * Touch samples carry segment coordinates and are 'active' for as long as
+ * the finger is down, so the first active sample is the press. Motion only
+ * keeps the latest position per finger, the press and release go out right
+ * away behind whatever motion that finger still had pending.
+ */
 static inline void process_touch(struct arcan_shmif_cont *prim,
                                  struct arcan_shmif_cont *cure,
                                  SDL_Window *wnd,
                                  Arcan_SDL_Meta *meta,
                                  arcan_ioevent ev)
 {
-//    SDL_SendTouch(ev.devid, ev.subid, ev.touch.active, ...);
+    SDL_TouchID touch = ev.devid;
+    SDL_FingerID finger = ev.subid;
+    float x, y;
+    int i, slot = -1;
+
+    if (ev.datatype != EVENT_IDATATYPE_TOUCH || !cure->w || !cure->h){
+        return;
+    }
+
+    x = SDL_clamp((float) ev.input.touch.x / cure->w, 0.0f, 1.0f);
+    y = SDL_clamp((float) ev.input.touch.y / cure->h, 0.0f, 1.0f);
+
+    for (i = 0; i < ARCAN_MAX_FINGERS; i++){
+        if (meta->fingers[i].used &&
+            meta->fingers[i].touch == touch && meta->fingers[i].finger == finger){
+            break;
+        }
+        if (!meta->fingers[i].used && slot == -1){
+            slot = i;
+        }
+    }
+
+    if (i < ARCAN_MAX_FINGERS){
+        if (ev.input.touch.active){
+            meta->fingers[i].x = x;
+            meta->fingers[i].y = y;
+            meta->fingers[i].pressure = ev.input.touch.pressure;
+            meta->fingers[i].dirty = true;
+        }
+        else {
+            flush_finger(wnd, meta, i);
+            meta->fingers[i].used = false;
+            SDL_SendTouch(touch, finger, wnd, SDL_FALSE, x, y,
+                          ev.input.touch.pressure);
+        }
+        return;
+    }
+
+/* a release for a finger we never saw go down, or out of slots */
+    if (!ev.input.touch.active || slot == -1){
+        return;
+    }
+
+    SDL_AddTouch(touch, SDL_TOUCH_DEVICE_DIRECT, "arcan");
+    meta->fingers[slot].used = true;
+    meta->fingers[slot].dirty = false;
+    meta->fingers[slot].touch = touch;
+    meta->fingers[slot].finger = finger;
+    SDL_SendTouch(touch, finger, wnd, SDL_TRUE, x, y, ev.input.touch.pressure);
+}
+
+/*
+ * Touch devices get registered on their first press, but a removal means the
+ * fingers it had down will never be released. Game devices are announced as
+ * they come and go so the joystick hotplug events match the server.
+ */
+static inline void process_status(struct arcan_shmif_cont *prim,
+                                  struct arcan_shmif_cont *cur,
+                                  SDL_Window *wnd,
+                                  Arcan_SDL_Meta *meta,
+                                  arcan_ioevent ev)
+{
+#ifdef SDL_JOYSTICK_ARCAN
+    if (ev.input.status.devkind == EVENT_IDEVKIND_GAMEDEV){
+        char label[sizeof(ev.label) + 1];
+        SDL_memcpy(label, ev.label, sizeof(ev.label));
+        label[sizeof(ev.label)] = '\0';
+
+        if (ev.input.status.action == EVENT_IDEV_ADDED){
+            ARCAN_JoystickAdded(ev.devid, label);
+        }
+        else if (ev.input.status.action == EVENT_IDEV_REMOVED){
+            ARCAN_JoystickRemoved(ev.devid);
+        }
+        return;
+    }
+#endif
+
+    if (ev.input.status.devkind != EVENT_IDEVKIND_TOUCHDISP ||
+        ev.input.status.action != EVENT_IDEV_REMOVED){
+        return;
+    }
+
+    for (int i = 0; i < ARCAN_MAX_FINGERS; i++){
+        if (meta->fingers[i].used && meta->fingers[i].touch == ev.devid){
+            meta->fingers[i].used = false;
+        }
+    }
+    SDL_DelTouch(ev.devid);
 }
 
 /*
@@ -146,6 +330,9 @@ static void process_input(struct arcan_shmif_cont* prim,
     else if (ev->io.devkind == EVENT_IDEVKIND_TOUCHDISP){
         process_touch(prim, cur, wnd, meta, ev->io);
     }
+    else if (ev->io.devkind == EVENT_IDEVKIND_STATUS){
+        process_status(prim, cur, wnd, meta, ev->io);
+    }
     else {
         process_gamedev(prim, cur, wnd, meta, ev->io);
     }
@@ -165,8 +352,10 @@ static void process_target(struct arcan_shmif_cont* prim,
 /* ignore, we don't have a way to communicate font changes within SDL */
     break;
     case TARGET_COMMAND_ATTENUATE:
-/* FIXME: if we don't run with ourself as an audio driver try and at least
- * change the mixing output gain */
+/* only takes effect if we run with ourself as the audio driver, it scales
+ * the samples as they are written into audp */
+        SDL_AtomicSet(&meta->audio_gain,
+                      (int) (SDL_clamp(ev.ioevs[0].fv, 0.0f, 1.0f) * 65536.0f));
     break;
     case TARGET_COMMAND_DEVICE_NODE:
 /* FIXME: need to indicate context loss and possily run into a suspend/
@@ -192,21 +381,20 @@ static void process_target(struct arcan_shmif_cont* prim,
 /* FIXME: send this as a DROPFILE if the state is enabled */
     break;
     case TARGET_COMMAND_STEPFRAME:
-/* FIXME: we don't really have control to implement this here, an option
- * would be to add the blocking to the window- update and have a frame-
- * counter in the related structure */
+/* the server paces this window from now on, each step lets the next present
+ * through (or several if it asks for that), unused ones don't pile up */
+        if (wnd && wnd->driverdata){
+            Arcan_WindowData *data = wnd->driverdata;
+            data->paced = true;
+            data->step_credit = SDL_max(1, ev.ioevs[0].iv);
+        }
     break;
     case TARGET_COMMAND_DISPLAYHINT:
-        if ((ev.ioevs[0].iv && ev.ioevs[1].iv) &&
-            (ev.ioevs[0].iv != cur->w || ev.ioevs[1].iv != cur->h)){
-            if (wnd->flags & SDL_WINDOW_RESIZABLE){
-/* FIXME: we need to lock audio here if we're on the primary segment */
-                if (arcan_shmif_resize(cur, ev.ioevs[0].iv, ev.ioevs[1].iv)){
-                    arcan_shmifext_make_current(cur);
-                    SDL_SendWindowEvent(wnd, SDL_WINDOWEVENT_RESIZED,
-                                        ev.ioevs[0].iv, ev.ioevs[1].iv);
-                }
-            }
+/* only the last hint in a batch matters, applied after the queue is drained */
+        if (ev.ioevs[0].iv && ev.ioevs[1].iv){
+            Arcan_WindowData *data = wnd->driverdata;
+            data->hint_w = ev.ioevs[0].iv;
+            data->hint_h = ev.ioevs[1].iv;
         }
  /* This only affects a client setting fullscreen, not accepting resize */
     case TARGET_COMMAND_OUTPUTHINT:
@@ -219,11 +407,24 @@ static void process_target(struct arcan_shmif_cont* prim,
     break;
     case TARGET_COMMAND_NEWSEGMENT:
 /* FIXME: if output segment, register new capture / audio device -
- * otherwise the only segment that should arrive here clipboard paste */
+ * otherwise the only segment that should arrive here clipboard paste.
+ * A new segment can only be acquired from the one it arrived on [cur], a
+ * paste may be pushed to whichever window has focus */
         if (ev.ioevs[2].iv == SEGID_CLIPBOARD_PASTE){
             if (!meta->clip_in.vidp){
                 meta->clip_in = arcan_shmif_acquire(
-                    prim, NULL, SEGID_CLIPBOARD_PASTE, 0);
+                    cur, NULL, SEGID_CLIPBOARD_PASTE, 0);
+
+/* let the server stream large pastes over a descriptor, see pumpClipboard */
+                if (meta->clip_in.addr){
+                    arcan_shmif_enqueue(&meta->clip_in, &(struct arcan_event){
+                        .ext.kind = ARCAN_EVENT(BCHUNKSTATE),
+                        .ext.bchunk = {
+                            .input = true,
+                            .extensions = "utf8"
+                        }
+                    });
+                }
             }
         }
 /*
@@ -232,9 +433,45 @@ static void process_target(struct arcan_shmif_cont* prim,
         else if (ev.ioevs[1].iv == 0 && ev.ioevs[3].iv == 0xc1b0a12d){
             if (!meta->clip_out.vidp){
                 meta->clip_out = arcan_shmif_acquire(
-                    prim, NULL, SEGID_CLIPBOARD, 0);
+                    cur, NULL, SEGID_CLIPBOARD, 0);
             }
         }
+        else if (cur != prim){
+/* everything below was requested on the primary and is answered there, the
+ * same id arriving on another segment is not ours to bind */
+        }
+/*
+ * the cursor segment requested at init
+ */
+        else if (ev.ioevs[3].uiv == ARCAN_CURSOR_REQID && meta->cursor_pending){
+            Arcan_BindCursor(prim, true);
+        }
+/*
+ * the SDL_ARCAN_RECORD output segment
+ */
+        else if (ev.ioevs[3].uiv == ARCAN_RECORD_REQID && meta->record_pending){
+            Arcan_BindRecord(prim, true);
+        }
+/*
+ * or one of the windows created without waiting for the segment
+ */
+        else {
+            Arcan_BindPendingWindow(SDL_GetVideoDevice(), prim, ev.ioevs[3].uiv);
+        }
+    break;
+    case TARGET_COMMAND_REQFAIL:
+        if (cur != prim){
+            break;
+        }
+        if (ev.ioevs[0].uiv == ARCAN_CURSOR_REQID && meta->cursor_pending){
+            Arcan_BindCursor(prim, false);
+            break;
+        }
+        if (ev.ioevs[0].uiv == ARCAN_RECORD_REQID && meta->record_pending){
+            Arcan_BindRecord(prim, false);
+            break;
+        }
+        Arcan_FailPendingWindow(SDL_GetVideoDevice(), ev.ioevs[0].uiv);
     break;
     default:
     break;
@@ -255,16 +492,280 @@ static void eventDispatch(struct arcan_shmif_cont* prim,
                           arcan_event *ev)
 {
     if (ev->category == EVENT_IO){
-        process_input(prim, cur, meta->main, meta, ev);
+        process_input(prim, cur, wnd, meta, ev);
     }
     else if (ev->category == EVENT_TARGET){
-        process_target(prim, cur, meta->main, meta, ev->tgt);
+        process_target(prim, cur, wnd, meta, ev->tgt);
     }
 }
 
-void Arcan_PumpEvents(_THIS)
+static void applyDisplayHint(struct arcan_shmif_cont* cur,
+                             SDL_Window *wnd,
+                             Arcan_SDL_Meta *meta)
+{
+    bool ok;
+    Arcan_WindowData *data = wnd->driverdata;
+    int w = data->hint_w;
+    int h = data->hint_h;
+
+    if (!w || !h){
+        return;
+    }
+    data->hint_w = data->hint_h = 0;
+
+/* the server scales the fullscreen window, the display size is not ours */
+    if (data->server_scaled){
+        return;
+    }
+
+    if ((w != cur->w || h != cur->h) && (wnd->flags & SDL_WINDOW_RESIZABLE)){
+        arcan_av_resize_begin(meta, cur);
+        ok = arcan_shmif_resize(cur, w, h);
+        arcan_av_resize_end(meta, cur);
+        if (ok){
+            arcan_shmifext_make_current(cur);
+            SDL_SendWindowEvent(wnd, SDL_WINDOWEVENT_RESIZED, w, h);
+        }
+    }
+}
+
+/*
+ * Drain everything queued on one segment before emitting the state that we
+ * coalesce (motion, resize) so that a burst costs one SDL event, not one
+ * per sample.
+ */
+static void drainSegment(struct arcan_shmif_cont* prim,
+                         struct arcan_shmif_cont* cur,
+                         SDL_Window *wnd,
+                         Arcan_SDL_Meta *meta)
+{
+    Arcan_WindowData *data = wnd->driverdata;
+    arcan_event ev;
+
+/* whatever Arcan_PaceFrame read while waiting for a step goes first */
+    for (size_t i = 0; i < data->deferred_n; i++){
+        eventDispatch(prim, cur, wnd, meta, &data->deferred[i]);
+        if (arcan_shmif_descrevent(&data->deferred[i]) &&
+            data->deferred[i].tgt.ioevs[0].iv != -1){
+            close(data->deferred[i].tgt.ioevs[0].iv);
+        }
+    }
+    data->deferred_n = 0;
+
+    while (arcan_shmif_poll(cur, &ev) > 0){
+        eventDispatch(prim, cur, wnd, meta, &ev);
+    }
+
+    flush_mouse(wnd, meta);
+    flush_touch(wnd, meta);
+    applyDisplayHint(cur, wnd, meta);
+    Arcan_NotePresented(wnd);
+}
+
+/*
+ * The audio buffers share the primary segment with the main window, if the
+ * resize moved vidp the window contents are gone and need to be redrawn.
+ */
+static void applyAudioResize(struct arcan_shmif_cont* prim,
+                             Arcan_SDL_Meta *meta)
+{
+    Arcan_WindowData *data = meta->main->driverdata;
+    int abuf_cnt = SDL_AtomicSet(&meta->audio_abuf_cnt, 0);
+
+    if (abuf_cnt <= 0 || !arcan_av_resize_audio(meta, prim, abuf_cnt)){
+        return;
+    }
+
+    if (meta->main->surface && !data->local_buf){
+        meta->main->surface->pixels = prim->vidp;
+    }
+    Arcan_InvalidatePresent(meta->main);
+    SDL_SendWindowEvent(meta->main, SDL_WINDOWEVENT_EXPOSED, 0, 0);
+}
+
+/*
+ * Pastes grow geometrically so a multi-megabyte paste arriving as thousands of
+ * MESSAGE events or descriptor reads stays linear in the size.
+ */
+static bool clipAppend(Arcan_SDL_Meta *meta, const char *buf, size_t len)
+{
+    if (meta->clip_tmp_used + len + 1 > meta->clip_tmp_sz){
+        size_t nsz = meta->clip_tmp_sz ? meta->clip_tmp_sz : 4096;
+        char *nbuf;
+
+        while (nsz < meta->clip_tmp_used + len + 1){
+            nsz *= 2;
+        }
+
+        nbuf = SDL_realloc(meta->clip_tmp, nsz);
+        if (!nbuf){
+            return false;
+        }
+        meta->clip_tmp = nbuf;
+        meta->clip_tmp_sz = nsz;
+    }
+
+    SDL_memcpy(&meta->clip_tmp[meta->clip_tmp_used], buf, len);
+    meta->clip_tmp_used += len;
+    meta->clip_tmp[meta->clip_tmp_used] = '\0';
+    return true;
+}
+
+static void clipReset(Arcan_SDL_Meta *meta)
+{
+    SDL_free(meta->clip_tmp);
+    meta->clip_tmp = NULL;
+    meta->clip_tmp_used = meta->clip_tmp_sz = 0;
+}
+
+static void clipFinish(Arcan_SDL_Meta *meta)
+{
+    if (meta->clip_in_fd != -1){
+        close(meta->clip_in_fd);
+        meta->clip_in_fd = -1;
+    }
+
+/* an empty paste still replaces the previous one */
+    if (!meta->clip_tmp && !clipAppend(meta, "", 0)){
+        return;
+    }
+
+    SDL_free(meta->clip_last);
+    meta->clip_last = meta->clip_tmp;
+    meta->clip_tmp = NULL;
+    meta->clip_tmp_used = meta->clip_tmp_sz = 0;
+    SDL_SendClipboardUpdate();
+}
+
+/*
+ * Both descriptors are non-blocking and only serviced for a bounded amount per
+ * pump, a large transfer is spread over several pumps rather than stalling
+ * one. The wait set keeps polling them so the next pump comes right away.
+ */
+static void pumpClipboard(Arcan_SDL_Meta *meta)
 {
     arcan_event ev;
+    size_t budget;
+
+    while (arcan_shmif_poll(&meta->clip_in, &ev) > 0){
+        if (ev.category != EVENT_TARGET){
+            continue;
+        }
+
+        if (ev.tgt.kind == TARGET_COMMAND_MESSAGE){
+            size_t len;
+
+/* a descriptor transfer supersedes any message stream */
+            if (meta->clip_in_fd != -1){
+                continue;
+            }
+
+            len = SDL_strlen(ev.tgt.message);
+            if (!clipAppend(meta, ev.tgt.message, len)){
+                clipReset(meta);
+                continue;
+            }
+
+            if (!ev.tgt.ioevs[0].iv){ /* multipart flag cleared, finished */
+                clipFinish(meta);
+            }
+        }
+        else if (ev.tgt.kind == TARGET_COMMAND_BCHUNK_IN){
+/* the descriptor is closed on the next poll, keep our own copy */
+            if (meta->clip_in_fd != -1){
+                close(meta->clip_in_fd);
+            }
+            clipReset(meta);
+            meta->clip_in_fd = arcan_shmif_dupfd(ev.tgt.ioevs[0].iv, -1, false);
+        }
+    }
+
+    while (arcan_shmif_poll(&meta->clip_out, &ev) > 0){
+        if (ev.category == EVENT_TARGET &&
+            ev.tgt.kind == TARGET_COMMAND_BCHUNK_OUT){
+            if (meta->clip_out_fd != -1){
+                close(meta->clip_out_fd);
+            }
+            meta->clip_out_fd = -1;
+            if (meta->clip_send){
+                meta->clip_send_used = 0;
+                meta->clip_out_fd =
+                    arcan_shmif_dupfd(ev.tgt.ioevs[0].iv, -1, false);
+            }
+        }
+    }
+
+/* no descriptor coming, the server can't take bchunks or dropped ours, so
+ * stream it as MESSAGE events, a late BCHUNK_OUT finds nothing to send */
+    if (meta->clip_send && meta->clip_out_fd == -1 &&
+        SDL_GetTicks64() - meta->clip_send_at >= ARCAN_CLIP_BCHUNK_WAIT){
+        arcan_event msgev = {
+            .ext.kind = ARCAN_EVENT(MESSAGE)
+        };
+        arcan_shmif_pushutf8(&meta->clip_out, &msgev,
+                             meta->clip_send, meta->clip_send_sz);
+        SDL_free(meta->clip_send);
+        meta->clip_send = NULL;
+        meta->clip_send_used = meta->clip_send_sz = 0;
+    }
+
+    budget = ARCAN_CLIP_BUDGET;
+    while (meta->clip_in_fd != -1 && budget){
+        char buf[4096];
+        ssize_t nr = read(meta->clip_in_fd, buf, SDL_min(sizeof(buf), budget));
+
+        if (nr > 0){
+            if (!clipAppend(meta, buf, nr)){
+                clipReset(meta);
+                close(meta->clip_in_fd);
+                meta->clip_in_fd = -1;
+                break;
+            }
+            budget -= nr;
+        }
+        else if (nr == 0){
+            clipFinish(meta);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK){
+            break;
+        }
+        else if (errno != EINTR){
+            clipReset(meta);
+            close(meta->clip_in_fd);
+            meta->clip_in_fd = -1;
+        }
+    }
+
+    budget = ARCAN_CLIP_BUDGET;
+    while (meta->clip_out_fd != -1 && budget){
+        size_t left = meta->clip_send_sz - meta->clip_send_used;
+        ssize_t nw = write(meta->clip_out_fd,
+            &meta->clip_send[meta->clip_send_used], SDL_min(left, budget));
+
+        if (nw > 0){
+            meta->clip_send_used += nw;
+            budget -= nw;
+        }
+        else if (nw < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        else if (nw < 0 && errno == EINTR){
+            continue;
+        }
+
+/* done, or the reader went away, either way the transfer is over */
+        if (nw <= 0 || meta->clip_send_used == meta->clip_send_sz){
+            close(meta->clip_out_fd);
+            meta->clip_out_fd = -1;
+            SDL_free(meta->clip_send);
+            meta->clip_send = NULL;
+            meta->clip_send_used = meta->clip_send_sz = 0;
+        }
+    }
+}
+
+void Arcan_PumpEvents(_THIS)
+{
     struct arcan_shmif_cont *prim = arcan_shmif_primary(SHMIF_INPUT);
     struct arcan_shmif_cont *con = prim;
     Arcan_SDL_Meta *meta = con->user;
@@ -273,6 +774,9 @@ void Arcan_PumpEvents(_THIS)
     if (!con || !con->user || !meta->main)
         return;
 
+    meta->coalesce_mouse =
+        SDL_GetHintBoolean(SDL_HINT_ARCAN_MOUSE_COALESCE, SDL_TRUE);
+
 /* events that might have accumulated while waiting for a subseg req. */
     if (meta->pqueue){
         for (int i = 0; i < meta->pqueue_sz && meta->pqueue_sz > 0; i++){
@@ -287,45 +791,220 @@ void Arcan_PumpEvents(_THIS)
         meta->pqueue_sz = 0;
    }
 
-/* we maintain multiple con to handle events for all possible subsegs */
-    SDL_LockMutex(meta->av_sync);
-    while (con && meta->main){
-        while (arcan_shmif_poll(con, &ev) > 0){
-            eventDispatch(prim, con, meta->main, meta, &ev);
+/* buffer count change the audio thread left for us, see SDL_ARCAN_AUDIO_LATENCY */
+    applyAudioResize(prim, meta);
+
+/* one pass over every live window segment, each dispatching to its owner,
+ * the audio thread only needs to be kept out while the primary resizes and
+ * that is handled by arcan_av_resize_begin/end where it happens */
+    for (SDL_Window *wnd = _this->windows; wnd; wnd = wnd->next){
+        Arcan_WindowData *data = wnd->driverdata;
+        if (!data || !data->con || !data->con->addr){
+            continue;
         }
+        drainSegment(prim, data->con, wnd, meta);
+    }
+
+    pumpClipboard(meta);
+    Arcan_PumpRecord(meta);
+}
 
-/* defer / aggregate mouse events to reduce the cost of accumulated events */
-        if (meta->dirty_mouse && meta->main){
-            SDL_SendMouseMotion(meta->main, 0, meta->mrel, meta->mx, meta->my);
-            meta->dirty_mouse = false;
+/*
+ * Keep an event read while waiting for a step for the next pump. Anything
+ * carrying a descriptor gets a copy of it, shmif closes the original on the
+ * next poll.
+ */
+static void deferEvent(Arcan_WindowData *data, arcan_event *ev)
+{
+    if (data->deferred_n == data->deferred_sz){
+        size_t nsz = data->deferred_sz ? data->deferred_sz * 2 : 8;
+        arcan_event *nq = SDL_realloc(data->deferred, nsz * sizeof(arcan_event));
+        if (!nq){
+            return;
         }
+        data->deferred = nq;
+        data->deferred_sz = nsz;
+    }
 
-/* FIXME: should switch to next window here */
-        con = NULL;
+    if (arcan_shmif_descrevent(ev) && ev->tgt.ioevs[0].iv != -1){
+        ev->tgt.ioevs[0].iv = arcan_shmif_dupfd(ev->tgt.ioevs[0].iv, -1, true);
     }
+    data->deferred[data->deferred_n++] = *ev;
+}
 
-    while (arcan_shmif_poll(&meta->clip_in, &ev) > 0){
-        if (ev.category == EVENT_TARGET
-            && ev.tgt.kind == TARGET_COMMAND_MESSAGE){
-            if (!meta->clip_tmp) {
-                meta->clip_tmp = SDL_strdup(ev.tgt.message);
+void Arcan_DropDeferred(SDL_Window *window)
+{
+    Arcan_WindowData *data = window->driverdata;
+
+    for (size_t i = 0; i < data->deferred_n; i++){
+        if (arcan_shmif_descrevent(&data->deferred[i]) &&
+            data->deferred[i].tgt.ioevs[0].iv != -1){
+            close(data->deferred[i].tgt.ioevs[0].iv);
+        }
+    }
+    SDL_free(data->deferred);
+    data->deferred = NULL;
+    data->deferred_n = data->deferred_sz = 0;
+}
+
+/*
+ * The caller is in the middle of a present and still holds the current
+ * buffers, so only the step is acted on here. A new segment has to be
+ * acquired before the next poll or it is gone, and binding one doesn't touch
+ * this window, so those (and refusals, to keep their order) go through too.
+ */
+void Arcan_PaceFrame(_THIS, SDL_Window *window)
+{
+    Arcan_WindowData *data = window->driverdata;
+    struct arcan_shmif_cont *prim = arcan_shmif_primary(SHMIF_INPUT);
+    Uint32 start = SDL_GetTicks();
+
+    while (data->paced && !data->pending && data->step_credit <= 0){
+        struct pollfd pfd = {.fd = data->con->epipe, .events = POLLIN};
+        int left = ARCAN_STEP_TIMEOUT - (int) (SDL_GetTicks() - start);
+        arcan_event ev;
+        int rv;
+
+        if (!data->con->addr || !data->con->addr->dms){
+            break;
+        }
+
+/* the server stopped stepping, present unpaced until the next STEPFRAME */
+        if (left <= 0){
+            data->paced = false;
+            break;
+        }
+
+        poll(&pfd, 1, left);
+        while ((rv = arcan_shmif_poll(data->con, &ev)) > 0){
+            if (ev.category == EVENT_TARGET &&
+                (ev.tgt.kind == TARGET_COMMAND_STEPFRAME ||
+                 ev.tgt.kind == TARGET_COMMAND_NEWSEGMENT ||
+                 ev.tgt.kind == TARGET_COMMAND_REQFAIL)){
+                eventDispatch(prim, data->con, window, prim->user, &ev);
             }
             else {
-                char *tmp = meta->clip_tmp;
-                SDL_asprintf(&meta->clip_tmp, "%s%s", tmp, ev.tgt.message);
-                SDL_free(tmp);
+                deferEvent(data, &ev);
             }
+        }
+        if (rv < 0){
+            break;
+        }
+    }
 
-            if (!ev.tgt.ioevs[0].iv) { // clipboard finished    
-                if (meta->clip_last)
-                    SDL_free(meta->clip_last);
-                meta->clip_last = meta->clip_tmp;
-                meta->clip_tmp = NULL;
-            }
+    if (data->step_credit > 0){
+        data->step_credit--;
+    }
+    data->frames++;
+}
+
+/*
+ * The segments drained by Arcan_PumpEvents, each has an event pipe that gets
+ * signalled by the server when it has enqueued something for us.
+ */
+static int collectWaitSet(_THIS, struct pollfd *set, int lim)
+{
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    int n = 0;
+    set[n++] = (struct pollfd){.fd = meta->wakeup[0], .events = POLLIN};
+    set[n++] = (struct pollfd){.fd = meta->mcont.epipe, .events = POLLIN};
+    if (meta->clip_in.addr){
+        set[n++] = (struct pollfd){.fd = meta->clip_in.epipe, .events = POLLIN};
+    }
+    if (meta->clip_out.addr){
+        set[n++] = (struct pollfd){.fd = meta->clip_out.epipe, .events = POLLIN};
+    }
+    if (meta->clip_in_fd != -1){
+        set[n++] = (struct pollfd){.fd = meta->clip_in_fd, .events = POLLIN};
+    }
+    if (meta->clip_out_fd != -1){
+        set[n++] = (struct pollfd){.fd = meta->clip_out_fd, .events = POLLOUT};
+    }
+    if (meta->cursor.addr){
+        set[n++] = (struct pollfd){.fd = meta->cursor.epipe, .events = POLLIN};
+    }
+    if (meta->record.addr){
+        set[n++] = (struct pollfd){.fd = meta->record.epipe, .events = POLLIN};
+    }
+
+    for (SDL_Window *wnd = _this->windows; wnd && n < lim; wnd = wnd->next){
+        Arcan_WindowData *data = wnd->driverdata;
+        if (!data || !data->con || !data->con->addr || data->con == &meta->mcont){
+            continue;
+        }
+        set[n++] = (struct pollfd){.fd = data->con->epipe, .events = POLLIN};
+    }
+
+    return n;
+}
+
+int Arcan_WaitEventTimeout(_THIS, int timeout)
+{
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    SDL_Window *wnd;
+    struct pollfd *set;
+    SDL_bool isstack;
+    int lim = 8;
+    int n, rv;
+    bool clip_wait = false;
+
+    for (wnd = _this->windows; wnd; wnd = wnd->next){
+        lim++;
+    }
+
+    set = SDL_small_alloc(struct pollfd, lim, &isstack);
+    if (!set){
+        return SDL_OutOfMemory();
+    }
+
+    n = collectWaitSet(_this, set, lim);
+
+/* wake up in time to fall back if a clipboard bchunk is never picked up,
+ * and report that as a wakeup so the caller pumps rather than giving up */
+    if (meta->clip_send && meta->clip_out_fd == -1){
+        Uint64 waited = SDL_GetTicks64() - meta->clip_send_at;
+        int left = waited >= ARCAN_CLIP_BCHUNK_WAIT ?
+                   0 : (int) (ARCAN_CLIP_BCHUNK_WAIT - waited);
+        if (timeout < 0 || left < timeout){
+            timeout = left;
+            clip_wait = true;
+        }
+    }
+    rv = poll(set, n, timeout);
+
+    if (rv == 0){
+        SDL_small_free(set, isstack);
+        return clip_wait ? 1 : 0;
+    }
+
+    if (rv < 0){
+        SDL_small_free(set, isstack);
+/* interrupted, there might be a SDL_QUIT to pump */
+        if (errno == EINTR){
+            return 1;
         }
+        return rv;
+    }
+
+/* flush the wakeup pipe, the events themselves are already in the queue */
+    if (set[0].revents & POLLIN){
+        char buf[64];
+        while (read(meta->wakeup[0], buf, sizeof(buf)) > 0){}
     }
 
-    SDL_UnlockMutex(meta->av_sync);
+    SDL_small_free(set, isstack);
+    return 1;
+}
+
+void Arcan_SendWakeupEvent(_THIS, SDL_Window *window)
+{
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    char ch = 1;
+    ssize_t rv;
+
+/* non-blocking, if the pipe is full there is already a wakeup pending */
+    rv = write(meta->wakeup[1], &ch, 1);
+    (void) rv;
 }
 
 /* vi: set ts=4 sw=4 expandtab: */
@@ -22,3 +22,16 @@
 #include "SDL_arcanvideo.h"
 
 extern void Arcan_PumpEvents(_THIS);
+extern int Arcan_WaitEventTimeout(_THIS, int timeout);
+extern void Arcan_SendWakeupEvent(_THIS, SDL_Window *window);
+
+/*
+ * Call before every present of [window]. Once the server paces it through
+ * TARGET_COMMAND_STEPFRAME this holds the present back until the next step
+ * arrives, other events read meanwhile are left for the next pump. A server
+ * that stops stepping costs one timeout, then the window goes unpaced.
+ */
+extern void Arcan_PaceFrame(_THIS, SDL_Window *window);
+
+/* release events Arcan_PaceFrame held back for a window being destroyed */
+extern void Arcan_DropDeferred(SDL_Window *window);
@@ -25,17 +25,392 @@
 
 #include "../SDL_egl_c.h"
 #include "../SDL_sysvideo.h"
+#include "SDL_hints.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_timer.h"
 #include "SDL_arcanvideo.h"
 #include "SDL_arcanwindow.h"
+#include "SDL_arcanevent.h"
+#include "SDL_arcanrecord.h"
+
+#ifdef __SSE2__
+#define HAVE_SSE2_INTRINSICS 1
+#endif
+
+#ifdef __ARM_NEON
+#define HAVE_NEON_INTRINSICS 1
+#endif
+
+/* side of the square used for damage tracking, in pixels */
+#define ARCAN_TILE_SIZE 32
+
+static void
+freeTiles(Arcan_WindowData* data)
+{
+	SDL_free(data->tiles);
+	data->tiles = NULL;
+	data->tiles_w = data->tiles_h = 0;
+	data->tiles_valid = false;
+}
+
+/*
+ * Nothing in the buffers in rotation can be carried over, so the next presents
+ * copy the whole frame forward until each of the other buffers has had it.
+ */
+void
+Arcan_InvalidatePresent(SDL_Window* sdl_window)
+{
+	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
+	data->present_full = data->vbuf_cnt - 1;
+}
+
+/*
+ * Negotiate the number of video buffers for a software window. With more
+ * than one, signalling hands us the next buffer in [vidp] instead of waiting
+ * for the server to be done with the current one.
+ */
+void
+Arcan_SetupPresent(_THIS, SDL_Window* sdl_window)
+{
+	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
+	const char* mode = SDL_GetHint(SDL_HINT_ARCAN_PRESENT_MODE);
+	struct shmif_resize_ext ext = {
+		.abuf_sz = data->con->abufsize,
+		.abuf_cnt = -1,
+		.samplerate = data->con->samplerate,
+		.vbuf_cnt = 1
+	};
+	bool ok;
+
+	data->present_mask = SHMIF_SIGVID;
+	if (mode && SDL_strcasecmp(mode, "queue") == 0){
+		ext.vbuf_cnt = 2;
+	}
+	else if (mode && SDL_strcasecmp(mode, "drop") == 0){
+		ext.vbuf_cnt = 3;
+		data->present_mask |= SHMIF_SIGBLK_NONE;
+	}
+
+	arcan_av_resize_begin(_this->driverdata, data->con);
+	ok = arcan_shmif_resize_ext(data->con, sdl_window->w, sdl_window->h, ext);
+	arcan_av_resize_end(_this->driverdata, data->con);
+
+/* the server is free to grant fewer buffers than we asked for, and with a
+ * failed resize we are left with the single one we had */
+	data->vbuf_cnt = 1;
+	if (ok && data->con->addr->vpending > 1){
+		data->vbuf_cnt = SDL_min(data->con->addr->vpending, ext.vbuf_cnt);
+	}
+	Arcan_InvalidatePresent(sdl_window);
+}
 
 int
 Arcan_CreateWindowFramebuffer(_THIS, SDL_Window* sdl_window, Uint32* format,
                             void** pixels, int* pitch)
 {
 	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
-	*format = SDL_PIXELFORMAT_ABGR8888;
+	Arcan_SDL_Meta* meta = _this->driverdata;
+	*format = meta->format;
+
+/* any previous surface is gone by now, so is whatever pointed to local_buf */
+	SDL_free(data->local_buf);
+	data->local_buf = NULL;
+
+	if (data->pending){
+		data->local_w = sdl_window->w;
+		data->local_h = sdl_window->h;
+		data->local_buf = SDL_calloc(data->local_w * data->local_h, sizeof(shmif_pixel));
+		if (!data->local_buf){
+			return SDL_OutOfMemory();
+		}
+		*pixels = data->local_buf;
+		*pitch = data->local_w * sizeof(shmif_pixel);
+		return 0;
+	}
+
 	*pixels = data->con->vidp;
 	*pitch = data->con->stride;
+
+/* fresh buffers after a resize, nothing to carry over between them */
+	Arcan_InvalidatePresent(sdl_window);
+
+	freeTiles(data);
+	if (SDL_GetHintBoolean(SDL_HINT_ARCAN_DAMAGE_TRACKING, SDL_FALSE)){
+		data->tiles_w = (data->con->w + ARCAN_TILE_SIZE - 1) / ARCAN_TILE_SIZE;
+		data->tiles_h = (data->con->h + ARCAN_TILE_SIZE - 1) / ARCAN_TILE_SIZE;
+		data->tiles = SDL_calloc(data->tiles_w * data->tiles_h, sizeof(Uint32));
+/* not fatal, we just lose the tracking */
+		if (!data->tiles){
+			data->tiles_w = data->tiles_h = 0;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Four independent djb2- style lanes, pixel x feeds lane (x & 3). This keeps
+ * the scalar and the vector paths producing the same checksum so they can be
+ * mixed on tiles of odd widths.
+ */
+static Uint32
+hashTile(const Uint32* src, size_t pitch, int w, int h)
+{
+	Uint32 lanes[4] = {5381, 5381, 5381, 5381};
+	int y = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+	static int has_sse2 = -1;
+	if (has_sse2 == -1){
+		has_sse2 = SDL_HasSSE2();
+	}
+	if (has_sse2 && (w & 3) == 0){
+		__m128i acc = _mm_set1_epi32(5381);
+		for (; y < h; y++, src += pitch){
+			for (int x = 0; x < w; x += 4){
+				__m128i px = _mm_loadu_si128((const __m128i*) &src[x]);
+				acc = _mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(acc, 5), acc), px);
+			}
+		}
+		_mm_storeu_si128((__m128i*) lanes, acc);
+	}
+#elif defined(HAVE_NEON_INTRINSICS)
+	static int has_neon = -1;
+	if (has_neon == -1){
+		has_neon = SDL_HasNEON();
+	}
+	if (has_neon && (w & 3) == 0){
+		uint32x4_t acc = vdupq_n_u32(5381);
+		for (; y < h; y++, src += pitch){
+			for (int x = 0; x < w; x += 4){
+				uint32x4_t px = vld1q_u32(&src[x]);
+				acc = veorq_u32(vaddq_u32(vshlq_n_u32(acc, 5), acc), px);
+			}
+		}
+		vst1q_u32(lanes, acc);
+	}
+#endif
+
+	for (; y < h; y++, src += pitch){
+		for (int x = 0; x < w; x++){
+			Uint32 a = lanes[x & 3];
+			lanes[x & 3] = ((a << 5) + a) ^ src[x];
+		}
+	}
+
+	return lanes[0] ^ (lanes[1] * 31) ^ (lanes[2] * 961) ^ (lanes[3] * 29791);
+}
+
+static int
+rectArea(const SDL_Rect* r)
+{
+	return r->w * r->h;
+}
+
+/*
+ * The damage of an update is synched as one region with a single signal, so
+ * the server never picks up a frame where only parts of it have been updated
+ * and a blocking present costs one round-trip. Grow it by [r].
+ */
+static void
+addDirty(SDL_Rect* bounds, const SDL_Rect* r)
+{
+	if (SDL_RectEmpty(bounds)){
+		*bounds = *r;
+	}
+	else {
+		SDL_UnionRect(bounds, r, bounds);
+	}
+}
+
+static void
+signalRegion(Arcan_WindowData* data, const SDL_Rect* r)
+{
+	struct arcan_shmif_cont* con = data->con;
+	con->dirty.x1 = r->x;
+	con->dirty.y1 = r->y;
+	con->dirty.x2 = r->x + r->w;
+	con->dirty.y2 = r->y + r->h;
+	con->addr->vpts = data->frame_pts;
+	arcan_shmif_signal(con, data->present_mask);
+}
+
+static void
+copyRegion(struct arcan_shmif_cont* con, shmif_pixel* src, const SDL_Rect* r)
+{
+	for (int y = r->y; y < r->y + r->h; y++){
+		SDL_memcpy(&con->vidp[y * con->pitch + r->x],
+		           &src[y * con->pitch + r->x], r->w * sizeof(shmif_pixel));
+	}
+}
+
+static void
+copyLocal(Arcan_WindowData* data, const SDL_Rect* r)
+{
+	struct arcan_shmif_cont* con = data->con;
+	shmif_pixel* src = data->local_buf;
+	for (int y = r->y; y < r->y + r->h; y++){
+		SDL_memcpy(&con->vidp[y * con->pitch + r->x],
+		           &src[y * data->local_w + r->x], r->w * sizeof(shmif_pixel));
+	}
+}
+
+/*
+ * With several buffers in rotation the one we get back holds an older frame,
+ * so bring it up to date with what changed since, to keep the semantics of
+ * SDL_UpdateWindowSurfaceRects where untouched pixels persist.
+ */
+static void
+presentBuffered(SDL_Window* sdl_window, Arcan_WindowData* data,
+                const SDL_Rect* full, const SDL_Rect* damage)
+{
+	struct arcan_shmif_cont* con = data->con;
+	shmif_pixel* prev = con->vidp;
+	SDL_Rect carry = *damage;
+
+	signalRegion(data, damage);
+	if (con->vidp == prev){
+		data->last_damage = *damage;
+		return;
+	}
+
+	if (data->present_full > 0){
+		data->present_full--;
+		carry = *full;
+	}
+	else if (data->vbuf_cnt > 2){
+		SDL_UnionRect(&carry, &data->last_damage, &carry);
+	}
+
+	copyRegion(con, prev, &carry);
+	data->last_damage = *damage;
+
+	if (sdl_window->surface && !data->local_buf){
+		sdl_window->surface->pixels = con->vidp;
+	}
+}
+
+/*
+ * Re-checksum the tiles covered by [r] and add horizontal runs of changed
+ * tiles to the damage. Tiles outside of what the application claims to
+ * have updated are left alone.
+ */
+static void
+trackDamage(Arcan_WindowData* data, const SDL_Rect* full,
+            const SDL_Rect* r, SDL_Rect* bounds)
+{
+	struct arcan_shmif_cont* con = data->con;
+	int tx1 = r->x / ARCAN_TILE_SIZE;
+	int ty1 = r->y / ARCAN_TILE_SIZE;
+	int tx2 = (r->x + r->w - 1) / ARCAN_TILE_SIZE;
+	int ty2 = (r->y + r->h - 1) / ARCAN_TILE_SIZE;
+
+	for (int ty = ty1; ty <= ty2; ty++){
+		int run = -1;
+		for (int tx = tx1; tx <= tx2 + 1; tx++){
+			bool dirty = false;
+			if (tx <= tx2){
+				int px = tx * ARCAN_TILE_SIZE;
+				int py = ty * ARCAN_TILE_SIZE;
+				int tw = SDL_min(ARCAN_TILE_SIZE, full->w - px);
+				int th = SDL_min(ARCAN_TILE_SIZE, full->h - py);
+				Uint32* slot = &data->tiles[ty * data->tiles_w + tx];
+				Uint32 hash = hashTile(&con->vidp[py * con->pitch + px],
+				                       con->pitch, tw, th);
+				dirty = !data->tiles_valid || hash != *slot;
+				*slot = hash;
+			}
+
+			if (dirty && run == -1){
+				run = tx;
+			}
+			else if (!dirty && run != -1){
+				SDL_Rect tr = {
+					run * ARCAN_TILE_SIZE, ty * ARCAN_TILE_SIZE,
+					(tx - run) * ARCAN_TILE_SIZE, ARCAN_TILE_SIZE
+				};
+				if (SDL_IntersectRect(&tr, full, &tr)){
+					addDirty(bounds, &tr);
+				}
+				run = -1;
+			}
+		}
+	}
+}
+
+static int
+synchFramebuffer(_THIS, SDL_Window* sdl_window,
+                 const SDL_Rect* rects, int numrects)
+{
+	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
+	struct arcan_shmif_cont* con = data->con;
+	SDL_Rect full = {0, 0, con->w, con->h};
+	SDL_Rect bounds = {0, 0, 0, 0};
+
+/* nothing to synch to yet, the local buffer is picked up when bound */
+	if (data->pending){
+		return 0;
+	}
+
+/* every region signalled for this update belongs to the same frame */
+	data->frame_pts = SDL_GetTicks64();
+
+/* the surface still lives in the buffer used while the window was pending */
+	if (data->local_buf){
+		SDL_Rect local = {0, 0, data->local_w, data->local_h};
+		SDL_IntersectRect(&local, &full, &local);
+		for (int i = 0; i < numrects; i++){
+			SDL_Rect r;
+			if (SDL_IntersectRect(&rects[i], &local, &r)){
+				copyLocal(data, &r);
+			}
+		}
+	}
+
+/* the segment might have been resized under us without a new surface */
+	if (data->tiles && (data->tiles_w * ARCAN_TILE_SIZE < con->w ||
+	                    data->tiles_h * ARCAN_TILE_SIZE < con->h)){
+		freeTiles(data);
+	}
+
+	for (int i = 0; i < numrects; i++){
+		SDL_Rect r;
+		if (!SDL_IntersectRect(&rects[i], &full, &r)){
+			continue;
+		}
+		if (data->tiles){
+			trackDamage(data, &full, &r, &bounds);
+		}
+		else {
+			addDirty(&bounds, &r);
+		}
+	}
+
+/* only when the whole buffer has been hashed do we have a reference frame */
+	if (data->tiles && !data->tiles_valid){
+		data->tiles_valid = !SDL_RectEmpty(&bounds) && numrects == 1 &&
+			rects[0].x <= 0 && rects[0].y <= 0 &&
+			rects[0].x + rects[0].w >= full.w && rects[0].y + rects[0].h >= full.h;
+	}
+
+	if (SDL_RectEmpty(&bounds)){
+		return 0;
+	}
+
+/* when most of the buffer is touched just send all of it */
+	if (rectArea(&bounds) * 4 >= rectArea(&full) * 3){
+		bounds = full;
+	}
+
+	if (data->vbuf_cnt > 1){
+		presentBuffered(sdl_window, data, &full, &bounds);
+	}
+	else {
+		signalRegion(data, &bounds);
+	}
+
+/* either way vidp now holds the frame just signalled */
+	Arcan_RecordFrame(_this->driverdata, sdl_window, &bounds, 1);
 	return 0;
 }
 
@@ -43,14 +418,51 @@ int
 Arcan_UpdateWindowFramebuffer(_THIS, SDL_Window* sdl_window,
                             const SDL_Rect* rects, int numrects)
 {
-	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
-	arcan_shmif_signal(data->con, SHMIF_SIGVID);
-	return 0;
+	Arcan_PaceFrame(_this, sdl_window);
+	return synchFramebuffer(_this, sdl_window, rects, numrects);
 }
 
 void
 Arcan_DestroyWindowFramebuffer(_THIS, SDL_Window* sdl_window)
 {
+	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
+	if (data){
+		freeTiles(data);
+		SDL_free(data->local_buf);
+		data->local_buf = NULL;
+	}
+}
+
+/*
+ * The segment for a pending window has arrived, move what was drawn so far
+ * over and, if the layout allows it, let the surface point into the segment
+ * directly from now on.
+ */
+void
+Arcan_BindWindowFramebuffer(_THIS, SDL_Window* sdl_window)
+{
+	Arcan_WindowData* data = (Arcan_WindowData*) sdl_window->driverdata;
+	struct arcan_shmif_cont* con = data->con;
+	SDL_Rect full = {0, 0, con->w, con->h};
+	SDL_Rect local = {0, 0, data->local_w, data->local_h};
+
+	if (!data->local_buf){
+		return;
+	}
+
+	if (SDL_IntersectRect(&local, &full, &local)){
+		copyLocal(data, &local);
+	}
+
+	if (sdl_window->surface && sdl_window->surface->pixels == data->local_buf &&
+	    data->local_w == con->w && data->local_h == con->h &&
+	    con->stride == data->local_w * sizeof(shmif_pixel)){
+		sdl_window->surface->pixels = con->vidp;
+		SDL_free(data->local_buf);
+		data->local_buf = NULL;
+	}
+
+	synchFramebuffer(_this, sdl_window, &full, 1);
 }
 
 #endif
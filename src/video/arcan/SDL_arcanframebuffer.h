@@ -29,6 +29,12 @@
 #include "../SDL_sysvideo.h"
 #include "SDL_arcanvideo.h"
 
+extern void
+Arcan_SetupPresent(_THIS, SDL_Window* sdl_window);
+
+extern void
+Arcan_InvalidatePresent(SDL_Window* sdl_window);
+
 extern int
 Arcan_CreateWindowFramebuffer(_THIS, SDL_Window* sdl_window, Uint32* format,
                             void** pixels, int* pitch);
@@ -40,6 +46,9 @@ Arcan_UpdateWindowFramebuffer(_THIS, SDL_Window* sdl_window,
 extern void
 Arcan_DestroyWindowFramebuffer(_THIS, SDL_Window* sdl_window);
 
+extern void
+Arcan_BindWindowFramebuffer(_THIS, SDL_Window* sdl_window);
+
 #endif /* _SDL_arcanframebuffer_h */
 
 /* vi: set ts=4 sw=4 expandtab: */
@@ -39,87 +39,205 @@
 #include "SDL_mouse.h"
 #include "../../events/SDL_mouse_c.h"
 #include "SDL_arcanvideo.h"
+#include "SDL_arcanmouse.h"
 
 #include "SDL_assert.h"
 
-typedef struct {
+/* unreferenced images kept around for a cursor that gets created again */
+#define ARCAN_CURSOR_CACHE 32
+
+/*
+ * Converted cursor images are keyed on a checksum of the source pixels and
+ * the hotspot, so an animated cursor that is recreated every frame only pays
+ * for a conversion and an upload the first time each frame is seen. [buffer]
+ * holds the converted pixels, a matching checksum is confirmed against them.
+ */
+struct arcan_cursor_image {
+    struct arcan_cursor_image *next;
+    int refc;
+    Uint32 crc;
+    Uint32 format;
     int hot_x, hot_y;
     int w, h;
-    char cursor_type[64];
     shmif_pixel buffer[0];
+};
+
+typedef struct {
+    char cursor_type[64];
+    struct arcan_cursor_image *img;
 } Arcan_CursorData;
 
-static SDL_Cursor* allocCursor(const char* system,
-                               SDL_Surface* surf, int hot_x, int hot_y)
+static void freeImage(Arcan_SDL_Meta *wd, struct arcan_cursor_image *img)
 {
-    SDL_Cursor *cursor = calloc(1, sizeof (*cursor));
-    size_t buf_sz = surf ? surf->w * surf->h * sizeof(shmif_pixel) : 0;
-    Arcan_CursorData *data = calloc (1, sizeof (Arcan_CursorData) + buf_sz);
-    SDL_VideoDevice *vd = SDL_GetVideoDevice();
-    Arcan_SDL_Meta *wd = (Arcan_SDL_Meta *) vd->driverdata;
+    struct arcan_cursor_image **cur = &wd->cursor_cache;
 
-    if (!cursor){
-        SDL_OutOfMemory();
-        return NULL;
+    while (*cur && *cur != img){
+        cur = &(*cur)->next;
     }
-
-    if (!data){
-        SDL_OutOfMemory();
-        free(cursor);
-        return NULL;
+    if (*cur){
+        *cur = img->next;
+        wd->cursor_cache_sz--;
     }
+    if (wd->cursor_shown == img){
+        wd->cursor_shown = NULL;
+    }
+    SDL_free(img);
+}
 
-/* don't know if we can handle native cursor or not, try and get one */
-    if (surf){
-        if (!wd->cursor.addr && !wd->cursor_reject){
-            struct arcan_event acqev;
-            arcan_shmif_enqueue(&wd->mcont, &(struct arcan_event){
-                .ext.kind = ARCAN_EVENT(SEGREQ),
-                .ext.segreq.width = surf->w,
-                .ext.segreq.height = surf->h,
-                .ext.segreq.kind = SEGID_CURSOR,
-                .ext.segreq.id = 0xbad1dea
-            });
-            if (arcan_shmif_acquireloop(&wd->mcont,
-                                       &acqev, &wd->pqueue, &wd->pqueue_sz)){
-                wd->cursor = arcan_shmif_acquire(&wd->mcont,
-                                                 NULL, SEGID_CURSOR, 0);
-            }
-            else{
-                wd->cursor_reject = true;
+/* drop the least recently used images no cursor refers to */
+static void trimCache(Arcan_SDL_Meta *wd)
+{
+    while (wd->cursor_cache_sz > ARCAN_CURSOR_CACHE){
+        struct arcan_cursor_image *victim = NULL;
+
+        for (struct arcan_cursor_image *cur = wd->cursor_cache; cur; cur = cur->next){
+            if (cur->refc == 0 && cur != wd->cursor_shown){
+                victim = cur;
             }
+        }
 
-/* pqueue is flushed as part of the normal event queue */
+        if (!victim){
+            return;
         }
+        freeImage(wd, victim);
+    }
+}
 
-        if (wd->cursor_reject){
-            free(cursor);
-            free(data);
-            return NULL;
+/* checksum of the source rows, read in place without the pitch padding */
+static Uint32 hashSurface(SDL_Surface* surf)
+{
+    size_t row_sz = surf->w * surf->format->BytesPerPixel;
+    Uint32 crc = 0;
+
+    for (int y = 0; y < surf->h; y++){
+        crc = SDL_crc32(crc, (uint8_t*)surf->pixels + y * surf->pitch, row_sz);
+    }
+    return crc;
+}
+
+/*
+ * The checksums match, make sure the source really converts to [img]. Done a
+ * row at a time so a mismatch usually costs a row, and a hit skips the
+ * allocation and upload of a new image.
+ */
+static bool sameImage(Arcan_SDL_Meta *wd, struct arcan_cursor_image *img,
+                      SDL_Surface* surf, shmif_pixel *row)
+{
+    size_t row_sz = surf->w * sizeof(shmif_pixel);
+
+    for (int y = 0; y < surf->h; y++){
+        if (0 != SDL_ConvertPixels(surf->w, 1, surf->format->format,
+                                   (uint8_t*)surf->pixels + y * surf->pitch,
+                                   surf->pitch, wd->format, row, row_sz) ||
+            memcmp(row, &img->buffer[y * surf->w], row_sz) != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+static struct arcan_cursor_image* lookupImage(Arcan_SDL_Meta *wd,
+                                              SDL_Surface* surf,
+                                              int hot_x, int hot_y)
+{
+    size_t buf_sz = surf->w * surf->h * sizeof(shmif_pixel);
+    struct arcan_cursor_image **prev, *img;
+    shmif_pixel *row = NULL;
+    Uint32 crc = hashSurface(surf);
+
+/* move hits to the front so trimming evicts the ones unused the longest */
+    for (prev = &wd->cursor_cache; *prev; prev = &(*prev)->next){
+        img = *prev;
+        if (img->crc != crc || img->format != surf->format->format ||
+            img->w != surf->w || img->h != surf->h ||
+            img->hot_x != hot_x || img->hot_y != hot_y){
+            continue;
+        }
+
+        if (!row){
+            row = SDL_malloc(surf->w * sizeof(shmif_pixel));
+            if (!row){
+                break;
+            }
         }
 
-        data->hot_x = hot_x;
-        data->hot_y = hot_y;
-        data->w = surf->w;
-        data->h = surf->h;
+        if (sameImage(wd, img, surf, row)){
+            *prev = img->next;
+            img->next = wd->cursor_cache;
+            wd->cursor_cache = img;
+            SDL_free(row);
+            return img;
+        }
     }
+    SDL_free(row);
 
-    cursor->driverdata = (void *) data;
+    img = SDL_calloc(1, sizeof(*img) + buf_sz);
+    if (!img){
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    img->crc = crc;
+    img->format = surf->format->format;
+    img->hot_x = hot_x;
+    img->hot_y = hot_y;
+    img->w = surf->w;
+    img->h = surf->h;
+
+    if (0 != SDL_ConvertPixels(surf->w, surf->h,
+                               surf->format->format, surf->pixels,
+                               surf->pitch, wd->format, img->buffer,
+                               surf->w * sizeof(shmif_pixel))){
+        SDL_free(img);
+        return NULL;
+    }
+
+    img->next = wd->cursor_cache;
+    wd->cursor_cache = img;
+    wd->cursor_cache_sz++;
+    trimCache(wd);
+    return img;
+}
+
+static SDL_Cursor* allocCursor(const char* system,
+                               SDL_Surface* surf, int hot_x, int hot_y)
+{
+    SDL_Cursor *cursor = SDL_calloc(1, sizeof (*cursor));
+    Arcan_CursorData *data = SDL_calloc(1, sizeof (Arcan_CursorData));
+    SDL_VideoDevice *vd = SDL_GetVideoDevice();
+    Arcan_SDL_Meta *wd = (Arcan_SDL_Meta *) vd->driverdata;
+
+    if (!cursor || !data){
+        SDL_free(cursor);
+        SDL_free(data);
+        SDL_OutOfMemory();
+        return NULL;
+    }
 
+/* the segment was requested at init, if the server refused it there is no
+ * way to show a custom cursor - while still pending the image is kept and
+ * shown once the segment arrives */
     if (surf){
-        if (0 != SDL_ConvertPixels(surf->w, surf->h,
-                                   surf->format->format, surf->pixels,
-                                   surf->pitch, wd->format, data->buffer,
-                                   surf->w * sizeof(shmif_pixel))){
-            free(cursor);
-            free(data);
+        if (wd->cursor_reject){
+            SDL_free(cursor);
+            SDL_free(data);
+            SDL_Unsupported();
             return NULL;
-       }
+        }
+
+        data->img = lookupImage(wd, surf, hot_x, hot_y);
+        if (!data->img){
+            SDL_free(cursor);
+            SDL_free(data);
+            return NULL;
+        }
+        data->img->refc++;
     }
     else {
         snprintf(data->cursor_type, 64, "%s", system);
     }
 
+    cursor->driverdata = (void *) data;
     return cursor;
 }
 
@@ -178,39 +296,61 @@ Arcan_CreateSystemCursor(SDL_SystemCursor id)
 static void
 Arcan_FreeCursor(SDL_Cursor *cursor)
 {
+    Arcan_CursorData *cd;
+
     if (!cursor || !cursor->driverdata)
         return;
 
-    free (cursor->driverdata);
+/* the image stays cached until trimmed, it is likely to be used again */
+    cd = cursor->driverdata;
+    if (cd->img){
+        SDL_VideoDevice *vd = SDL_GetVideoDevice();
+        cd->img->refc--;
+        if (vd && vd->driverdata){
+            trimCache(vd->driverdata);
+        }
+    }
+
+    SDL_free(cd);
     SDL_free(cursor);
 }
 
-static void synchCursor(struct arcan_shmif_cont *dst, Arcan_CursorData *cd)
+static void synchCursor(Arcan_SDL_Meta *d, struct arcan_cursor_image *img)
 {
+    struct arcan_shmif_cont *dst = &d->cursor;
+
+/* same content is the same cache entry, nothing to upload */
+    if (d->cursor_shown == img){
+        return;
+    }
+
 /* anti tearing precaution, being limited to cursor should only happen in
  * rare cases of bugs / abuse */
     while (dst->addr->vready){}
 
-/* FIXME:
- * only synch if the cursor is different from the last one */
-
-    if (cd->w > dst->w || cd->h > dst->h){
-        if (!arcan_shmif_resize(dst, cd->w, cd->h))
+    if (img->w > dst->w || img->h > dst->h){
+        if (!arcan_shmif_resize(dst, img->w, img->h))
             return;
         memset(dst->vidb, '\0', dst->h * dst->stride);
     }
+/* a smaller image would leave the previous one around its edges */
+    else if (d->cursor_shown &&
+             (img->w < d->cursor_shown->w || img->h < d->cursor_shown->h)){
+        memset(dst->vidb, '\0', dst->h * dst->stride);
+    }
 
 /* assumes no padding/alignment for buffer */
-    for (size_t y = 0; y < cd->h; y++){
+    for (size_t y = 0; y < img->h; y++){
         memcpy(
                &dst->vidp[dst->pitch * y],
-               &cd->buffer[y * cd->w],
-               sizeof(shmif_pixel) * cd->w
+               &img->buffer[y * img->w],
+               sizeof(shmif_pixel) * img->w
               );
     }
 
 /* FIXME: set hotspot to match */
     arcan_shmif_signal(dst, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
+    d->cursor_shown = img;
 }
 
 static int
@@ -227,14 +367,17 @@ Arcan_ShowCursor(SDL_Cursor *cursor)
         struct arcan_event outev = {
             .ext.kind = ARCAN_EVENT(CURSORHINT)
         };
-        if (d->cursor.addr){
-            if (cd->cursor_type[0] == '\0'){
-                synchCursor(&d->cursor, cd);
-                return 0;
+        if (cd->img){
+            if (d->cursor.addr){
+                synchCursor(d, cd->img);
             }
+            return 0;
+        }
+        if (d->cursor.addr){
             dst = &d->cursor;
         }
-/* system cursor */
+/* system cursor, the segment needs a new upload to show an image again */
+        d->cursor_shown = NULL;
         snprintf((char*)outev.ext.message.data,
             sizeof(outev.ext.message.data)/sizeof(outev.ext.message.data[0]),
             "%s", cd->cursor_type);
@@ -242,6 +385,7 @@ Arcan_ShowCursor(SDL_Cursor *cursor)
     }
     else
     {
+        d->cursor_shown = NULL;
         if (d->cursor.addr){
             arcan_shmif_enqueue(&d->mcont, &(struct arcan_event){
                 .ext.kind = ARCAN_EVENT(CURSORHINT),
@@ -271,10 +415,11 @@ Arcan_SetRelativeMouseMode(SDL_bool enabled)
         return SDL_Unsupported();
 
     arcan_data = vd->driverdata;
-    for (size_t i = 0; i < sizeof(arcan_data->windows)/
-                           sizeof(arcan_data->windows)[0]; i++){
-        if (arcan_data->windows[i].addr)
-            hintRelative(&arcan_data->windows[i], enabled);
+    for (size_t i = 0; i < arcan_data->wnd_reg_sz; i++){
+        SDL_Window *wnd = arcan_data->wnd_reg[i].window;
+        Arcan_WindowData *data = wnd ? wnd->driverdata : NULL;
+        if (data && data->con && data->con->addr)
+            hintRelative(data->con, enabled);
     }
 
     hintRelative(&arcan_data->mcont, enabled);
@@ -290,28 +435,96 @@ Arcan_GetGlobalMouseState(int *x, int *y)
     return 0;//mouse->buttonstate;
 }
 
+/*
+ * Called from the event pump when the cursor segment requested in
+ * Arcan_InitMouse has been provided, or [ok] is false if it got refused.
+ */
+void
+Arcan_BindCursor(struct arcan_shmif_cont *prim, bool ok)
+{
+    Arcan_SDL_Meta *d = prim->user;
+
+    d->cursor_pending = false;
+    if (!ok){
+        d->cursor_reject = true;
+        return;
+    }
+
+    d->cursor = arcan_shmif_acquire(prim, NULL, SEGID_CURSOR, 0);
+    if (!d->cursor.addr){
+        d->cursor_reject = true;
+        return;
+    }
+
+/* a custom cursor set before the segment arrived can be shown now */
+    d->cursor_shown = NULL;
+    if (SDL_GetMouse()->cursor_shown){
+        SDL_SetCursor(NULL);
+    }
+}
+
+/*
+ * The primary is going away, the cursor segment has to go before it and any
+ * images still cached are no longer reachable.
+ */
+void
+Arcan_ReleaseCursor(Arcan_SDL_Meta *d)
+{
+    while (d->cursor_cache){
+        freeImage(d, d->cursor_cache);
+    }
+    if (d->cursor.addr){
+        arcan_shmif_drop(&d->cursor);
+        SDL_zero(d->cursor);
+    }
+}
+
 void
 Arcan_InitMouse(void)
 {
     SDL_Mouse *mouse = SDL_GetMouse();
+    SDL_VideoDevice *vd = SDL_GetVideoDevice();
+    Arcan_SDL_Meta *d = vd->driverdata;
+
+/* request the cursor segment up front rather than blocking on it in the
+ * first CreateCursor, the event pump binds it whenever it arrives */
+    if (!d->cursor.addr && !d->cursor_reject && !d->cursor_pending){
+        arcan_shmif_enqueue(&d->mcont, &(struct arcan_event){
+            .ext.kind = ARCAN_EVENT(SEGREQ),
+            .ext.segreq.width = 32,
+            .ext.segreq.height = 32,
+            .ext.segreq.kind = SEGID_CURSOR,
+            .ext.segreq.id = ARCAN_CURSOR_REQID
+        });
+        d->cursor_pending = true;
+    }
 
     mouse->CreateCursor = Arcan_CreateCursor;
     mouse->CreateSystemCursor = Arcan_CreateSystemCursor;
     mouse->ShowCursor = Arcan_ShowCursor;
     mouse->FreeCursor = Arcan_FreeCursor;
     mouse->GetGlobalMouseState = Arcan_GetGlobalMouseState;
+    mouse->SetRelativeMouseMode = Arcan_SetRelativeMouseMode;
 }
 
 void
 Arcan_FiniMouse(void)
 {
     SDL_Mouse *mouse = SDL_GetMouse();
+    SDL_VideoDevice *vd = SDL_GetVideoDevice();
 
     if (mouse->def_cursor != mouse->cur_cursor)
         Arcan_FreeCursor(mouse->cur_cursor);
 
     Arcan_FreeCursor (mouse->def_cursor);
     mouse->def_cursor = mouse->cur_cursor = NULL;
+
+    if (vd && vd->driverdata){
+        Arcan_SDL_Meta *d = vd->driverdata;
+        while (d->cursor_cache){
+            freeImage(d, d->cursor_cache);
+        }
+    }
     mouse->CreateCursor =  NULL;
     mouse->CreateSystemCursor = NULL;
     mouse->ShowCursor = NULL;
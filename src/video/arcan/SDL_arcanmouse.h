@@ -24,7 +24,14 @@
 
 #if SDL_VIDEO_DRIVER_ARCAN
 
+#include "SDL_arcanvideo.h"
+
+/* segment request id for the cursor segment asked for at init */
+#define ARCAN_CURSOR_REQID 0xbad1dea
+
 extern void Arcan_InitMouse(void);
 extern void Arcan_FiniMouse(void);
+extern void Arcan_BindCursor(struct arcan_shmif_cont *prim, bool ok);
+extern void Arcan_ReleaseCursor(Arcan_SDL_Meta *d);
 
 #endif
@@ -33,7 +33,9 @@
 
 #include "SDL_arcanopengl.h"
 #include "SDL_arcanvideo.h"
+#include "SDL_arcanevent.h"
 #include "SDL_opengl.h"
+#include "SDL_timer.h"
 
 /*
  * only GL functions we need
@@ -61,6 +63,9 @@ Arcan_GL_SwapWindow(_THIS, SDL_Window* window)
     Arcan_WindowData* wnd = window->driverdata;
 
     glocFlush();
+    Arcan_PaceFrame(_this, window);
+    wnd->frame_pts = SDL_GetTicks64();
+    wnd->con->addr->vpts = wnd->frame_pts;
     arcan_shmifext_signal(wnd->con, 0, SHMIF_SIGVID, SHMIFEXT_BUILTIN);
     arcan_shmifext_bind(wnd->con);
     current = wnd->con;
@@ -0,0 +1,264 @@
+/*
+  Simple DirectMedia Layer
+  Copyright (C) 1997-2016 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "../../SDL_internal.h"
+
+#if SDL_VIDEO_DRIVER_ARCAN
+
+#include <unistd.h>
+
+#include "../SDL_sysvideo.h"
+#include "SDL_hints.h"
+#include "SDL_arcanvideo.h"
+#include "SDL_arcanrecord.h"
+
+/* audio buffers of the record segment, signalled without waiting on the
+ * server so a slow encoder never stalls playback */
+#define ARCAN_RECORD_ABUF 4
+
+void
+Arcan_InitRecord(Arcan_SDL_Meta *meta)
+{
+    if (meta->record.addr || meta->record_pending ||
+        !SDL_GetHintBoolean(SDL_HINT_ARCAN_RECORD, SDL_FALSE)){
+        return;
+    }
+
+/* like the cursor, the event pump binds it whenever it arrives */
+    arcan_shmif_enqueue(&meta->mcont, &(struct arcan_event){
+        .ext.kind = ARCAN_EVENT(SEGREQ),
+        .ext.segreq.width = meta->mcont.w,
+        .ext.segreq.height = meta->mcont.h,
+        .ext.segreq.kind = SEGID_MEDIA,
+        .ext.segreq.id = ARCAN_RECORD_REQID
+    });
+    meta->record_pending = true;
+}
+
+/*
+ * The segment asked for in Arcan_InitRecord has been provided, or [ok] is
+ * false if it got refused, in which case we simply don't record.
+ */
+void
+Arcan_BindRecord(struct arcan_shmif_cont *prim, bool ok)
+{
+    Arcan_SDL_Meta *meta = prim->user;
+
+    meta->record_pending = false;
+    if (!ok){
+        return;
+    }
+
+    meta->record = arcan_shmif_acquire(prim, NULL, SEGID_MEDIA, 0);
+    if (!meta->record.addr){
+        return;
+    }
+
+/* so the server knows to route it to an encoder rather than show it */
+    arcan_shmif_enqueue(&meta->record, &(struct arcan_event){
+        .ext.kind = ARCAN_EVENT(IDENT),
+        .ext.message.data = "record"
+    });
+
+    meta->record_w = meta->record_h = 0;
+    SDL_AtomicSet(&meta->record_ready, 1);
+}
+
+void
+Arcan_FiniRecord(Arcan_SDL_Meta *meta)
+{
+    meta->record_pending = false;
+    if (!meta->record.addr){
+        return;
+    }
+
+/* the audio thread may have seen [record_ready] just before this, so the
+ * context has to be gone before it is let back in */
+    arcan_av_resize_begin(meta, &meta->record);
+    SDL_AtomicSet(&meta->record_ready, 0);
+    arcan_shmif_drop(&meta->record);
+    SDL_zero(meta->record);
+    arcan_av_resize_end(meta, &meta->record);
+}
+
+/*
+ * Nothing the server sends on the record segment concerns us, but its queue
+ * has to keep moving and it is the server that decides when recording ends.
+ */
+void
+Arcan_PumpRecord(Arcan_SDL_Meta *meta)
+{
+    arcan_event ev;
+    int rv;
+
+    if (!meta->record.addr){
+        return;
+    }
+
+    while ((rv = arcan_shmif_poll(&meta->record, &ev)) > 0){
+        if (arcan_shmif_descrevent(&ev) && ev.tgt.ioevs[0].iv != -1){
+            close(ev.tgt.ioevs[0].iv);
+        }
+        if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT){
+            rv = -1;
+            break;
+        }
+    }
+
+    if (rv < 0 || !meta->record.addr->dms){
+        Arcan_FiniRecord(meta);
+    }
+}
+
+/*
+ * Keep the record segment at the size of the window and with the audio
+ * format of the primary, anything in vidp is lost on a resize.
+ */
+static bool
+fitSegment(Arcan_SDL_Meta *meta, size_t w, size_t h)
+{
+    struct arcan_shmif_cont *rec = &meta->record;
+    struct shmif_resize_ext ext = {
+        .abuf_sz = meta->mcont.abufsize,
+        .abuf_cnt = ARCAN_RECORD_ABUF,
+        .samplerate = meta->mcont.samplerate,
+        .vbuf_cnt = 1
+    };
+
+    if (meta->record_w == w && meta->record_h == h &&
+        meta->record_abuf_sz == ext.abuf_sz &&
+        meta->record_rate == (size_t) ext.samplerate){
+        return rec->w == w && rec->h == h;
+    }
+
+    arcan_av_resize_begin(meta, rec);
+    arcan_shmif_resize_ext(rec, w, h, ext);
+    arcan_av_resize_end(meta, rec);
+
+/* remember what we asked for, not what we got, or a refusal would have us
+ * asking again on every frame */
+    meta->record_w = w;
+    meta->record_h = h;
+    meta->record_abuf_sz = ext.abuf_sz;
+    meta->record_rate = ext.samplerate;
+    meta->record_full = true;
+    return rec->w == w && rec->h == h;
+}
+
+void
+Arcan_RecordFrame(Arcan_SDL_Meta *meta, SDL_Window *window,
+                  const SDL_Rect *rects, int numrects)
+{
+    Arcan_WindowData *data = window->driverdata;
+    struct arcan_shmif_cont *src = data->con;
+    struct arcan_shmif_cont *rec = &meta->record;
+    SDL_Rect full = {0, 0, src->w, src->h};
+    SDL_Rect *r = &meta->record_dirty;
+
+    if (!rec->addr || window != meta->main){
+        return;
+    }
+
+    if (!fitSegment(meta, src->w, src->h)){
+        return;
+    }
+
+    for (int i = 0; i < numrects; i++){
+        if (SDL_RectEmpty(r)){
+            *r = rects[i];
+        }
+        else {
+            SDL_UnionRect(r, &rects[i], r);
+        }
+    }
+    if (meta->record_full){
+        *r = full;
+    }
+
+/* the server is still reading the previous frame, rather than tearing that
+ * one or waiting, its damage goes out with the next */
+    if (rec->addr->vready || !SDL_IntersectRect(r, &full, r)){
+        return;
+    }
+
+/* vidp still holds what was just signalled, no readback needed */
+    for (int y = r->y; y < r->y + r->h; y++){
+        SDL_memcpy(&rec->vidp[y * rec->pitch + r->x],
+                   &src->vidp[y * src->pitch + r->x],
+                   r->w * sizeof(shmif_pixel));
+    }
+
+    rec->dirty.x1 = r->x;
+    rec->dirty.y1 = r->y;
+    rec->dirty.x2 = r->x + r->w;
+    rec->dirty.y2 = r->y + r->h;
+    rec->addr->vpts = data->frame_pts;
+    arcan_shmif_signal(rec, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
+
+    SDL_zerop(r);
+    meta->record_full = false;
+}
+
+/*
+ * Runs on the audio thread, so it claims the segment the same way playback
+ * claims the primary and backs off rather than wait out a resize. Buffers of
+ * the two segments need not line up, apts is carried over per sample.
+ */
+void
+Arcan_RecordAudio(Arcan_SDL_Meta *meta, const Uint8 *buf, size_t len,
+                  int frame_sz, int freq, Uint64 apts)
+{
+    struct arcan_shmif_cont *rec = &meta->record;
+    size_t pos = 0;
+
+    if (!SDL_AtomicGet(&meta->record_ready) || frame_sz <= 0 || freq <= 0){
+        return;
+    }
+
+/* ready is checked again once claimed, the segment may have been dropped in
+ * between and the first check only saves the claim when not recording */
+    SDL_AtomicSet(&meta->record_busy, 1);
+    if (!SDL_AtomicGet(&meta->record_ready) ||
+        SDL_AtomicGet(&meta->record_resize) || !rec->audp ||
+        !rec->abufsize || rec->samplerate != (size_t) freq){
+        SDL_AtomicSet(&meta->record_busy, 0);
+        return;
+    }
+
+    while (pos < len){
+        size_t ntc = SDL_min(rec->abufsize - rec->abufused, len - pos);
+        if (!rec->abufused){
+            rec->addr->apts = apts + (pos / frame_sz) * 1000 / freq;
+        }
+        SDL_memcpy(&((Uint8*)rec->audp)[rec->abufused], &buf[pos], ntc);
+        rec->abufused += ntc;
+        pos += ntc;
+        if (rec->abufused == rec->abufsize){
+            arcan_shmif_signal(rec, SHMIF_SIGAUD | SHMIF_SIGBLK_NONE);
+        }
+    }
+
+    SDL_AtomicSet(&meta->record_busy, 0);
+}
+
+#endif
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,60 @@
+/*
+  Simple DirectMedia Layer
+  Copyright (C) 1997-2016 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _SDL_arcanrecord_h_
+#define _SDL_arcanrecord_h_
+
+#include "../../SDL_internal.h"
+
+#if SDL_VIDEO_DRIVER_ARCAN
+
+#include "SDL_arcanvideo.h"
+
+/* segment request id for the SDL_ARCAN_RECORD output segment */
+#define ARCAN_RECORD_REQID 0x5ec0de
+
+/*
+ * SDL_ARCAN_RECORD: a media subsegment of the primary that gets a copy of
+ * every frame presented by the main window and of every audio buffer played
+ * on the primary, with the same vpts / apts, for the server to encode.
+ */
+extern void Arcan_InitRecord(Arcan_SDL_Meta *meta);
+extern void Arcan_BindRecord(struct arcan_shmif_cont *prim, bool ok);
+extern void Arcan_PumpRecord(Arcan_SDL_Meta *meta);
+extern void Arcan_FiniRecord(Arcan_SDL_Meta *meta);
+
+/*
+ * Video thread, after [window] has signalled [rects] of the frame stamped
+ * with its frame_pts, vidp still holding that frame.
+ */
+extern void Arcan_RecordFrame(Arcan_SDL_Meta *meta, SDL_Window *window,
+                              const SDL_Rect *rects, int numrects);
+
+/*
+ * Audio thread, a buffer of [len] bytes about to be signalled on the primary
+ * with [apts] as the timestamp of its first sample.
+ */
+extern void Arcan_RecordAudio(Arcan_SDL_Meta *meta, const Uint8 *buf,
+                              size_t len, int frame_sz, int freq, Uint64 apts);
+
+#endif
+
+#endif /* _SDL_arcanrecord_h_ */
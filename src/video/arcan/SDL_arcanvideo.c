@@ -28,15 +28,21 @@
 #include "SDL_arcanwindow.h"
 #include "SDL_video.h"
 #include "SDL_stdinc.h"
+#include "SDL_timer.h"
+#include "SDL_pixels.h"
 
 #include "SDL_arcanframebuffer.h"
 #include "SDL_arcanopengl.h"
 #include "SDL_arcanvideo.h"
 #include "SDL_arcanevent.h"
 #include "SDL_arcanmouse.h"
+#include "SDL_arcanrecord.h"
 
 // #include "SDL_arcandyn.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 static int
 Arcan_VideoInit(_THIS);
 
@@ -78,6 +84,9 @@ static void
 Arcan_DeleteDevice(SDL_VideoDevice* device)
 {
     TRACE("DeleteDevice");
+    if (device->wakeup_lock){
+        SDL_DestroyMutex(device->wakeup_lock);
+    }
     SDL_free(device);
 //    SDL_Arcan_UnloadSymbols();
 }
@@ -123,6 +132,27 @@ Arcan_GetDisplayDPI(_THIS, SDL_VideoDisplay * display, float * ddpi, float * hdp
     return SDL_SetError("Couldn't get DPI");
 }
 
+/*
+ * The packing of shmif_pixel is decided when the shmif library is built, so
+ * derive the SDL format from the same macro the library uses. That way the
+ * window surface can be handed out as-is without a conversion pass.
+ */
+static Uint32
+Arcan_NativeFormat(void)
+{
+    Uint32 fmt = SDL_MasksToPixelFormatEnum(sizeof(shmif_pixel) * 8,
+                                            SHMIF_RGBA(0xff, 0x00, 0x00, 0x00),
+                                            SHMIF_RGBA(0x00, 0xff, 0x00, 0x00),
+                                            SHMIF_RGBA(0x00, 0x00, 0xff, 0x00),
+                                            SHMIF_RGBA(0x00, 0x00, 0x00, 0xff));
+
+    if (fmt == SDL_PIXELFORMAT_UNKNOWN){
+        return SDL_PIXELFORMAT_ABGR8888;
+    }
+
+    return fmt;
+}
+
 int
 Arcan_VideoInit(_THIS)
 {
@@ -146,13 +176,9 @@ Arcan_VideoInit(_THIS)
         mode.h = arcan_data->mcont.h;
     }
 
-/* FIXME:
- *  this is not technically correct, should be probed against the static
- *  build format (sizeof + checking packing macro for mask should help)
- */
-    mode.format = SDL_PIXELFORMAT_ABGR8888;
+    arcan_data->format = Arcan_NativeFormat();
+    mode.format = arcan_data->format;
     mode.driverdata = NULL;
-    arcan_data->format = SDL_PIXELFORMAT_ABGR8888;
     arcan_data->disp_w = mode.w;
     arcan_data->disp_h = mode.h;
     display.desktop_mode = mode;
@@ -164,6 +190,7 @@ Arcan_VideoInit(_THIS)
     SDL_AddDisplayMode(&display, &mode);
 
     Arcan_InitMouse();
+    Arcan_InitRecord(arcan_data);
     return 1;
 }
 
@@ -174,15 +201,17 @@ Arcan_VideoQuit(_THIS)
     Arcan_SDL_Meta *ameta = (Arcan_SDL_Meta *) cont->user;
     TRACE("VideoQuit");
 
-    SDL_LockMutex(ameta->av_sync);
-    ameta->refc--;
-    SDL_UnlockMutex(ameta->av_sync);
+    Arcan_FiniMouse();
+    Arcan_FiniRecord(ameta);
+
+    if (ameta->wakeup[0] != -1){
+        close(ameta->wakeup[0]);
+        close(ameta->wakeup[1]);
+        ameta->wakeup[0] = ameta->wakeup[1] = -1;
+    }
 
-    if (0 == ameta->refc){
-        arcan_shmif_drop(cont);
-        SDL_DestroyMutex(ameta->av_sync);
-        SDL_free(ameta);
-        arcan_shmif_setprimary(SHMIF_INPUT, NULL);
+    if (SDL_AtomicDecRef(&ameta->refc)){
+        arcan_av_teardown(ameta);
     }
 
     SDL_EGL_UnloadLibrary(_this);
@@ -210,10 +239,48 @@ Arcan_SetClipboardText(_THIS, const char* text)
         .ext.kind = ARCAN_EVENT(MESSAGE)
     };
     Arcan_SDL_Meta *meta = _this->driverdata;
+    size_t len;
+
     if (!meta->clip_out.vidp || !text)
         return 0;
 
-    arcan_shmif_pushutf8(&meta->clip_out, &msgev, text, strlen(text));
+    len = SDL_strlen(text);
+
+/*
+ * Each MESSAGE carries less than 80 bytes and pushutf8 blocks on a full event
+ * queue, so anything sizeable is announced as a bchunk instead and written by
+ * the event pump when the server hands us a descriptor. A copy that is still
+ * in flight is simply replaced, the server only ever wants the latest.
+ */
+    if (len >= ARCAN_CLIP_BCHUNK_SZ){
+        arcan_event bev = {
+            .ext.kind = ARCAN_EVENT(BCHUNKSTATE),
+            .ext.bchunk = {
+                .size = len,
+                .input = false,
+                .extensions = "utf8"
+            }
+        };
+        char *buf = SDL_malloc(len);
+        if (!buf)
+            return SDL_OutOfMemory();
+
+        SDL_memcpy(buf, text, len);
+        SDL_free(meta->clip_send);
+        meta->clip_send = buf;
+        meta->clip_send_sz = len;
+        meta->clip_send_used = 0;
+        meta->clip_send_at = SDL_GetTicks64();
+
+        if (meta->clip_out_fd != -1){
+            close(meta->clip_out_fd);
+            meta->clip_out_fd = -1;
+        }
+
+        arcan_shmif_enqueue(&meta->clip_out, &bev);
+    }
+    else
+        arcan_shmif_pushutf8(&meta->clip_out, &msgev, text, len);
 
     if (meta->clip_last)
         SDL_free(meta->clip_last);
@@ -266,15 +333,22 @@ int arcan_av_setup_primary()
             }
             return SDL_OutOfMemory();
         }
-        arcan_data->av_sync = SDL_CreateMutex();
-        if (!arcan_data->av_sync){
+        arcan_data->resize_lock = SDL_CreateMutex();
+        if (!arcan_data->resize_lock){
             SDL_free(arcan_data);
             return SDL_OutOfMemory();
         }
+        arcan_data->wakeup[0] = arcan_data->wakeup[1] = -1;
+        arcan_data->clip_in_fd = arcan_data->clip_out_fd = -1;
+        SDL_AtomicSet(&arcan_data->audio_gain, 65536);
 
         arcan_data->mcont = *cont;
         arcan_shmif_setprimary(SHMIF_INPUT, &arcan_data->mcont);
         arcan_data->mcont.user = arcan_data;
+
+/* the same samples feed both, one tracks the position and one the deltas */
+        arcan_shmif_mousestate_setup(&arcan_data->mcont, false, arcan_data->mstate);
+        arcan_shmif_mousestate_setup(&arcan_data->mcont, true, arcan_data->mstate_rel);
         if (SDL_GetRelativeMouseMode()){
             arcan_shmif_enqueue(cont, &(struct arcan_event){
                 .ext.kind = ARCAN_EVENT(CURSORHINT),
@@ -286,6 +360,91 @@ int arcan_av_setup_primary()
     return 0;
 }
 
+void arcan_av_teardown(Arcan_SDL_Meta *meta)
+{
+    if (meta->clip_in_fd != -1){
+        close(meta->clip_in_fd);
+    }
+    if (meta->clip_out_fd != -1){
+        close(meta->clip_out_fd);
+    }
+    SDL_free(meta->clip_tmp);
+    SDL_free(meta->clip_send);
+    SDL_free(meta->clip_last);
+    SDL_free(meta->wnd_reg);
+
+/* subsegments go before the primary they were derived from */
+    if (meta->clip_in.addr){
+        arcan_shmif_drop(&meta->clip_in);
+    }
+    if (meta->clip_out.addr){
+        arcan_shmif_drop(&meta->clip_out);
+    }
+    Arcan_ReleaseCursor(meta);
+    Arcan_FiniRecord(meta);
+
+    arcan_shmif_drop(&meta->mcont);
+    arcan_shmif_setprimary(SHMIF_INPUT, NULL);
+    SDL_DestroyMutex(meta->resize_lock);
+    SDL_free(meta);
+}
+
+void arcan_av_resize_begin(Arcan_SDL_Meta *meta, struct arcan_shmif_cont *cont)
+{
+/* only ever resized by the video thread, no lock, just keep audio out */
+    if (cont == &meta->record){
+        SDL_AtomicSet(&meta->record_resize, 1);
+        while (SDL_AtomicGet(&meta->record_busy)){
+            SDL_Delay(0);
+        }
+        return;
+    }
+
+    if (cont != &meta->mcont){
+        return;
+    }
+
+    SDL_LockMutex(meta->resize_lock);
+    SDL_AtomicSet(&meta->audio_resize, 1);
+    while (SDL_AtomicGet(&meta->audio_busy)){
+        SDL_Delay(0);
+    }
+}
+
+void arcan_av_resize_end(Arcan_SDL_Meta *meta, struct arcan_shmif_cont *cont)
+{
+    if (cont == &meta->record){
+        SDL_AtomicSet(&meta->record_resize, 0);
+        return;
+    }
+
+    if (cont != &meta->mcont){
+        return;
+    }
+
+    SDL_AtomicIncRef(&meta->audio_gen);
+    SDL_AtomicSet(&meta->audio_resize, 0);
+    SDL_UnlockMutex(meta->resize_lock);
+}
+
+bool arcan_av_resize_audio(Arcan_SDL_Meta *meta,
+                           struct arcan_shmif_cont *cont, int abuf_cnt)
+{
+    shmif_pixel *vidp = cont->vidp;
+    struct shmif_resize_ext ext = {
+        .abuf_sz = cont->abufsize,
+        .abuf_cnt = abuf_cnt,
+        .samplerate = cont->samplerate,
+        .vbuf_cnt = -1
+    };
+
+    arcan_av_resize_begin(meta, cont);
+    arcan_shmif_resize_ext(cont, cont->w, cont->h, ext);
+    arcan_av_resize_end(meta, cont);
+
+    return cont->vidp != vidp;
+}
+
 static SDL_VideoDevice*
 Arcan_CreateDevice()
 {
@@ -308,11 +467,26 @@ Arcan_CreateDevice()
     }
 
     arcan_data = (Arcan_SDL_Meta *) arcan_shmif_primary(SHMIF_INPUT)->user;
-    arcan_data->refc++;
+    SDL_AtomicIncRef(&arcan_data->refc);
 
     device = SDL_calloc(1, sizeof(SDL_VideoDevice));
     device->driverdata = arcan_data;
 
+/* lets SDL_WaitEvent sleep on the segment event pipes, the extra pipe is for
+ * SDL_PushEvent from other threads to get us out of that sleep */
+    if (arcan_data->wakeup[0] == -1 &&
+        pipe2(arcan_data->wakeup, O_CLOEXEC | O_NONBLOCK) == -1){
+        arcan_data->wakeup[0] = arcan_data->wakeup[1] = -1;
+    }
+    if (arcan_data->wakeup[0] != -1){
+        device->wakeup_lock = SDL_CreateMutex();
+    }
+
+/* fullscreen may leave the size to the server, so we report the resize,
+ * and the framebuffer is already the segment the server composes */
+    device->quirk_flags = VIDEO_DEVICE_QUIRK_FULLSCREEN_SENDS_RESIZE |
+                          VIDEO_DEVICE_QUIRK_FRAMEBUFFER_IS_SHARED;
+
     /* arcanvideo */
     device->VideoInit        = Arcan_VideoInit;
     device->VideoQuit        = Arcan_VideoQuit;
@@ -369,6 +543,10 @@ Arcan_CreateDevice()
     device->shape_driver.ResizeWindowShape = Arcan_ResizeWindowShape;
 
     device->PumpEvents = Arcan_PumpEvents;
+    if (device->wakeup_lock){
+        device->WaitEventTimeout = Arcan_WaitEventTimeout;
+        device->SendWakeupEvent = Arcan_SendWakeupEvent;
+    }
 
     /* arcan does that to us based on registered archetype already */
     device->SuspendScreenSaver = NULL;
@@ -30,37 +30,199 @@
 #define WANT_ARCAN_SHMIF_HELPER
 #include <arcan_shmif.h>
 #include "SDL_mutex.h"
+#include "SDL_atomic.h"
+#include "SDL_touch.h"
+
+/* fingers we track at once across all touch devices */
+#define ARCAN_MAX_FINGERS 16
+
+/* clipboard text at least this large goes through a bchunk descriptor rather
+ * than a stream of MESSAGE events */
+#define ARCAN_CLIP_BCHUNK_SZ 4096
+
+/* ms to wait for the server to hand us a descriptor for such a copy before
+ * sending it as MESSAGE events after all */
+#define ARCAN_CLIP_BCHUNK_WAIT 500
+
+/* regions the arcan render driver tracks per frame before it starts merging */
+#define ARCAN_RENDER_DIRTY 16
+
+/*
+ * Registry entry of a secondary window. [awaiting] holds the slot while the
+ * server has yet to answer its segment request, even if the window is gone
+ * by then, so a late answer can't reach a window that took over the slot.
+ */
+struct arcan_window_slot {
+    SDL_Window *window;
+    bool awaiting;
+
+/* while free, the next free slot + 1, 0 ends the list */
+    size_t next_free;
+};
 
 /*
  * This is shared between audio and video implementations as any negotiated
  * connection support both, and some operations on the connection need
- * synchronization (i.e. resize)
+ * synchronization (i.e. resize). [resize_lock] is only ever held across a
+ * resize of the primary segment, event processing and audio writes do not
+ * take it.
  */
 typedef struct {
     SDL_Window *main;
-    SDL_mutex* av_sync;
+    SDL_mutex* resize_lock;
     Uint32 format;
-    int refc;
+    SDL_atomic_t refc;
     uint8_t mstate[ASHMIF_MSTATE_SZ];
-    int mx, my, mrel;
+    uint8_t mstate_rel[ASHMIF_MSTATE_SZ];
+    int mx, my;
+    int dx, dy;
+    bool coalesce_mouse;
     bool dirty_mouse;
+
+/* fingers currently down, the latest motion of each is held until the queue
+ * of the segment has been drained */
+    struct {
+        bool used, dirty;
+        SDL_TouchID touch;
+        SDL_FingerID finger;
+        float x, y, pressure;
+    } fingers[ARCAN_MAX_FINGERS];
     bool cursor_reject;
+
+/* cursor segment requested at init but not yet provided, and the cache of
+ * converted cursor images with the one last uploaded to the segment */
+    bool cursor_pending;
+    struct arcan_cursor_image *cursor_cache;
+    struct arcan_cursor_image *cursor_shown;
+    size_t cursor_cache_sz;
     size_t n_windows;
     struct arcan_shmif_cont clip_in, clip_out, cursor, mcont;
-    char* clip_tmp;
     char* clip_last;
-    uint8_t wndalloc;
+
+/* paste in progress, MESSAGE chunks and BCHUNK_IN reads append to [clip_tmp]
+ * until the transfer completes and it replaces [clip_last] */
+    char* clip_tmp;
+    size_t clip_tmp_used, clip_tmp_sz;
+    int clip_in_fd;
+
+/* copy too large for MESSAGE chunks, announced as a bchunk at [clip_send_at]
+ * and written out by the event pump once the server has provided [clip_out_fd] */
+    char* clip_send;
+    size_t clip_send_used, clip_send_sz;
+    Uint64 clip_send_at;
+    int clip_out_fd;
     int disp_w, disp_h;
     struct arcan_event* pqueue;
     ssize_t pqueue_sz;
-    struct arcan_shmif_cont windows[8];
+    int wakeup[2];
+
+/* secondary windows by Arcan_WindowData.index, which is also the offset of
+ * their segment request id from ARCAN_WINDOW_REQID so NEWSEGMENT and REQFAIL
+ * map back to the window directly, slots get reused once both the window is destroyed
+ * and its request answered */
+    struct arcan_window_slot *wnd_reg;
+    size_t wnd_reg_sz;
+    size_t wnd_free;
+
+/*
+ * Lets the audio thread write into audp without a lock: it marks itself busy
+ * while it touches the buffer, a resize of the primary segment waits for that
+ * to clear and bumps the generation so cached buffer properties are
+ * re-derived.
+ */
+    SDL_atomic_t audio_busy;
+    SDL_atomic_t audio_resize;
+    SDL_atomic_t audio_gen;
+
+/* number of times the server drained every queued audio buffer */
+    SDL_atomic_t audio_underruns;
+
+/* set while a playback device owns the audio buffer of the primary segment */
+    SDL_atomic_t audio_primary;
+
+/* SDL_ARCAN_AUDIO_LATENCY: latest output latency estimate in ms, and a buffer
+ * count the primary's device wants that the event pump has yet to apply, the
+ * video side may be drawing into vidp so the resize has to happen there */
+    SDL_atomic_t audio_latency;
+    SDL_atomic_t audio_abuf_cnt;
+
+/* TARGET_COMMAND_ATTENUATE as 16.16 fixed point, applied by the audio write */
+    SDL_atomic_t audio_gain;
+
+/* SDL_ARCAN_RECORD: output segment the main window frames and the primary
+ * audio get copied to. The audio thread writes its audp under a busy/resize
+ * handshake like the one for the primary, see arcan_av_resize_begin. The
+ * size and audio format last asked for, and damage not yet copied over */
+    bool record_pending;
+    struct arcan_shmif_cont record;
+    SDL_atomic_t record_ready;
+    SDL_atomic_t record_busy;
+    SDL_atomic_t record_resize;
+    size_t record_w, record_h;
+    size_t record_abuf_sz, record_rate;
+    SDL_Rect record_dirty;
+    bool record_full;
 } Arcan_SDL_Meta;
 
 typedef struct {
     int index;
     struct arcan_shmif_cont *con;
+
+/* secondary windows own their segment, [con] points here or to the primary */
+    struct arcan_shmif_cont seg;
     int disp_w, disp_h;
     bool got_context;
+
+/* segment requested but not yet provided by the server, software windows
+ * draw into [local_buf] until then */
+    bool pending;
+    void *local_buf;
+    int local_w, local_h;
+
+/* last DISPLAYHINT size seen while draining the segment, 0 if none */
+    int hint_w, hint_h;
+
+/* fullscreen at the size of the window rather than the display, the server
+ * scales it on composition, see SDL_ARCAN_SERVER_SCALE */
+    bool server_scaled;
+
+/* SetWindowFullscreen while pending, replayed once the segment is bound */
+    bool fullscreen_deferred;
+    SDL_bool fullscreen_want;
+
+/* per-tile checksums of the last synched frame, for SDL_ARCAN_DAMAGE_TRACKING */
+    Uint32 *tiles;
+    int tiles_w, tiles_h;
+    bool tiles_valid;
+
+/* SDL_ARCAN_PRESENT_MODE: buffer count, signal mask and the damage of the
+ * previous frame that still needs to be carried over into the next buffer */
+    int vbuf_cnt;
+    int present_mask;
+    int present_full;
+    SDL_Rect last_damage;
+
+/* TARGET_COMMAND_STEPFRAME: set once the server paces the window, presents
+ * left before the next step is needed, and frames presented so far */
+    bool paced;
+    int step_credit;
+    Uint32 frames;
+
+/* events read while a present waited for its step, for the next pump */
+    arcan_event *deferred;
+    size_t deferred_n, deferred_sz;
+
+/* presentation timestamp (SDL_GetTicks64) of the frame last signalled, and
+ * of the last one we have seen the server pick up, with when that was seen */
+    Uint64 frame_pts;
+    Uint64 shown_pts;
+    Uint64 shown_at;
+
+/* what the arcan render driver has drawn into vidp since its last present,
+ * [render_full] when that is everything */
+    SDL_Rect render_dirty[ARCAN_RENDER_DIRTY];
+    int render_dirty_n;
+    bool render_full;
 } Arcan_WindowData;
 
 /*
@@ -70,6 +232,27 @@ typedef struct {
  */
 extern int arcan_av_setup_primary();
 
+/*
+ * Called by whichever of audio and video drops the last reference to [meta],
+ * releases the primary along with everything derived from it.
+ */
+extern void arcan_av_teardown(Arcan_SDL_Meta *meta);
+
+/*
+ * Wrap anything that can resize [cont], if it is the primary (audio carrying)
+ * segment this synchronizes with an audio thread mixing directly into audp,
+ * if it is the record segment with the audio thread copying into that.
+ */
+extern void arcan_av_resize_begin(Arcan_SDL_Meta *meta, struct arcan_shmif_cont *cont);
+extern void arcan_av_resize_end(Arcan_SDL_Meta *meta, struct arcan_shmif_cont *cont);
+
+/*
+ * Change the number of audio buffers of [cont] keeping everything else, true
+ * if that moved vidp and anything drawing into it needs to be redone.
+ */
+extern bool arcan_av_resize_audio(Arcan_SDL_Meta *meta,
+                                  struct arcan_shmif_cont *cont, int abuf_cnt);
+
 #endif /* _SDL_arcanvideo_h_ */
 
 /* vi: set ts=4 sw=4 expandtab: */
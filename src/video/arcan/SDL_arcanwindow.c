@@ -29,16 +29,137 @@
 
 #include "../SDL_egl_c.h"
 #include "../SDL_sysvideo.h"
+#include "SDL_hints.h"
+#include "SDL_timer.h"
 #include "../../events/SDL_keyboard_c.h"
 #include "../../events/SDL_mouse_c.h"
+#include "../../events/SDL_windowevents_c.h"
 #include "SDL_arcanvideo.h"
 #include "SDL_arcanwindow.h"
 #include "SDL_arcanopengl.h"
 #include "SDL_arcanevent.h"
+#include "SDL_arcanframebuffer.h"
 
 #define TRACE(...)
 //#define TRACE(...) {fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n");}
 
+/* request identifiers for window segments are the base plus the slot, the
+ * slot cap keeps them clear of the other request ids */
+#define ARCAN_WINDOW_REQID 0xfeed0000
+#define ARCAN_WINDOW_SLOTS 0x10000
+
+/*
+ * Free slots are chained through [next_free] with [wnd_free] as the head,
+ * both as index + 1 so the zeroed registry starts out with an empty list.
+ */
+static void
+releaseSlot(Arcan_SDL_Meta *meta, size_t index)
+{
+    struct arcan_window_slot *slot = &meta->wnd_reg[index];
+
+    if (slot->window || slot->awaiting){
+        return;
+    }
+    slot->next_free = meta->wnd_free;
+    meta->wnd_free = index + 1;
+}
+
+/* take a free slot from the registry, growing it if there is none */
+static int
+registerWindow(Arcan_SDL_Meta *meta, SDL_Window *window)
+{
+    size_t index;
+
+    if (!meta->wnd_free){
+        size_t nsz = meta->wnd_reg_sz ? meta->wnd_reg_sz * 2 : 8;
+        struct arcan_window_slot *nreg;
+
+        if (nsz > ARCAN_WINDOW_SLOTS){
+            nsz = ARCAN_WINDOW_SLOTS;
+        }
+        if (meta->wnd_reg_sz == nsz){
+            return -1;
+        }
+
+        nreg = SDL_realloc(meta->wnd_reg, nsz * sizeof(*nreg));
+        if (!nreg){
+            return -1;
+        }
+        SDL_memset(&nreg[meta->wnd_reg_sz], 0,
+                   (nsz - meta->wnd_reg_sz) * sizeof(*nreg));
+        meta->wnd_reg = nreg;
+
+        for (index = nsz; index > meta->wnd_reg_sz; index--){
+            releaseSlot(meta, index - 1);
+        }
+        meta->wnd_reg_sz = nsz;
+    }
+
+    index = meta->wnd_free - 1;
+    meta->wnd_free = meta->wnd_reg[index].next_free;
+    meta->wnd_reg[index].window = window;
+    return (int) index;
+}
+
+/* the slot of a request still waiting for an answer, NULL otherwise */
+static struct arcan_window_slot*
+lookupRequest(Arcan_SDL_Meta *meta, Uint32 id)
+{
+    Uint32 index = id - ARCAN_WINDOW_REQID;
+
+/* ids below the base wrap around to huge offsets and fail the bound as well */
+    if (index >= meta->wnd_reg_sz || !meta->wnd_reg[index].awaiting){
+        return NULL;
+    }
+    return &meta->wnd_reg[index];
+}
+
+/*
+ * Shared between creation and late binding of a pending window, picks the
+ * buffer setup for the kind of window and syncs the size we actually got.
+ */
+static void
+setupSegment(_THIS, SDL_Window* window)
+{
+    Arcan_WindowData *data = window->driverdata;
+
+/* ask for a step per display refresh, the first frame goes out unpaced */
+    if (SDL_GetHintBoolean(SDL_HINT_ARCAN_FRAME_PACING, SDL_FALSE)){
+        arcan_shmif_enqueue(data->con, &(struct arcan_event){
+            .ext.kind = ARCAN_EVENT(CLOCKREQ),
+            .ext.clock.rate = 1,
+            .ext.clock.dynamic = 1
+        });
+        data->paced = true;
+        data->step_credit = 1;
+    }
+
+    if (window->flags & SDL_WINDOW_OPENGL){
+        data->con->hints = SHMIF_RHINT_ORIGO_LL;
+        arcan_av_resize_begin(_this->driverdata, data->con);
+        arcan_shmif_resize(data->con, window->w, window->h);
+        arcan_shmifext_setup(data->con, Arcan_GL_cfg(_this, window));
+        arcan_av_resize_end(_this->driverdata, data->con);
+    }
+    else{
+/* the framebuffer path describes what changed through the dirty region */
+        data->con->hints = SHMIF_RHINT_SUBREGION;
+        arcan_shmifext_drop(data->con);
+        Arcan_SetupPresent(_this, window);
+    }
+}
+
+static void
+hintRelativeWindow(struct arcan_shmif_cont* con)
+{
+    if (SDL_GetRelativeMouseMode()){
+        arcan_shmif_enqueue(con, &(struct arcan_event){
+            .ext.kind = ARCAN_EVENT(CURSORHINT),
+            .ext.message.data = "hidden-rel"
+        });
+    }
+}
+
 int
 Arcan_CreateWindow(_THIS, SDL_Window* window)
 {
@@ -55,31 +176,40 @@ Arcan_CreateWindow(_THIS, SDL_Window* window)
             .ext.kind = ARCAN_EVENT(SEGREQ),
             .ext.segreq.width = window->w,
             .ext.segreq.height = window->h,
-            .ext.segreq.kind = SEGID_GAME,
-            .ext.segreq.id = 0xfeedface
+            .ext.segreq.kind = SEGID_GAME
         };
 
-        if (meta->wndalloc == 255){
+        index = registerWindow(meta, window);
+        if (index == -1){
+            SDL_free(data);
             return SDL_SetError("Out of Memory");
         }
-        while (meta->wndalloc & (1 << index))
-            index++;
 
+        data->index = index;
+        acqev.ext.segreq.id = ARCAN_WINDOW_REQID + index;
         arcan_shmif_enqueue(&meta->mcont, &acqev);
+
+/*
+ * Software windows don't need the segment to exist until something is drawn,
+ * so return right away and let the event pump bind it when the NEWSEGMENT
+ * arrives. The framebuffer renders into a local buffer until then. GL needs
+ * the segment to derive a context from, so there we still have to wait.
+ */
+        if (!(window->flags & SDL_WINDOW_OPENGL)){
+            data->con = &data->seg;
+            data->pending = true;
+            meta->wnd_reg[index].awaiting = true;
+        }
 /* FIXME: we must properly flush the pqueue in the event handler */
-        if (arcan_shmif_acquireloop(&meta->mcont,
+        else if (arcan_shmif_acquireloop(&meta->mcont,
                                     &acqev, &meta->pqueue, &meta->pqueue_sz)){
-            data->con = &meta->windows[index];
+            data->con = &data->seg;
             *(data->con) = arcan_shmif_acquire(&meta->mcont,NULL,SEGID_GAME, 0);
-            meta->wndalloc |= 1 << index;
-            if (SDL_GetRelativeMouseMode()){
-                arcan_shmif_enqueue(data->con, &(struct arcan_event){
-                    .ext.kind = ARCAN_EVENT(CURSORHINT),
-                    .ext.message.data = "hidden-rel"
-                });
-            }
+            hintRelativeWindow(data->con);
         }
         else {
+            meta->wnd_reg[index].window = NULL;
+            releaseSlot(meta, index);
             if (!meta->pqueue){
                 SDL_free(data);
                 return SDL_SetError("Out of Memory");
@@ -88,9 +218,12 @@ Arcan_CreateWindow(_THIS, SDL_Window* window)
                 SDL_free(data);
                 return SDL_SetError("Shmif- state inconsistent\n");
             }
+            SDL_free(data);
             return SDL_SetError("Arcan rejected window request\n");
         }
-        Arcan_PumpEvents(_this);
+        if (!data->pending){
+            Arcan_PumpEvents(_this);
+        }
     }
     else {
         meta->main = window;
@@ -111,25 +244,146 @@ Arcan_CreateWindow(_THIS, SDL_Window* window)
     window->y = 0;
     window->flags &= ~SDL_WINDOW_FULLSCREEN;
     window->flags |= SDL_WINDOW_INPUT_FOCUS;
+    data->disp_w = meta->disp_w;
+    data->disp_h = meta->disp_h;
 
-    if (window->flags & SDL_WINDOW_OPENGL){
-        data->con->hints = SHMIF_RHINT_ORIGO_LL;
-        arcan_shmif_resize(data->con, window->w, window->h);
-        arcan_shmifext_setup(data->con, Arcan_GL_cfg(_this, window));
-    }
-    else{
-        data->con->hints = 0;
-        arcan_shmifext_drop(data->con);
-        arcan_shmif_resize(data->con, window->w, window->h);
+    if (data->pending){
+        return 0;
     }
+
+    setupSegment(_this, window);
     window->w = data->con->w;
     window->h = data->con->h;
-    data->disp_w = meta->disp_w;
-    data->disp_h = meta->disp_h;
 
     return 0;
 }
 
+/*
+ * Tell the server how large we would like the segment to appear, with
+ * SDL_ARCAN_SERVER_SCALE that is the display while the buffer stays at the
+ * size the application draws at.
+ */
+static void
+hintViewport(struct arcan_shmif_cont* con, int w, int h)
+{
+    arcan_shmif_enqueue(con, &(struct arcan_event){
+        .category = EVENT_EXTERNAL,
+        .ext.kind = ARCAN_EVENT(VIEWPORT),
+        .ext.viewport.w = w,
+        .ext.viewport.h = h
+    });
+}
+
+/*
+ * Not our decision, we can try a viewport hint.  Some games actually track
+ * this though, and repeatedly check displayBounds to see if we match.
+ */
+static void
+applyFullscreen(_THIS, SDL_Window* window, SDL_bool fullscreen)
+{
+    Arcan_WindowData *data = window->driverdata;
+    int w, h;
+
+    if (fullscreen){
+        data->server_scaled =
+            SDL_GetHintBoolean(SDL_HINT_ARCAN_SERVER_SCALE, SDL_FALSE);
+        w = data->server_scaled ? data->con->w : data->disp_w;
+        h = data->server_scaled ? data->con->h : data->disp_h;
+    }
+    else {
+        w = window->windowed.w;
+        h = window->windowed.h;
+    }
+
+    if (w != data->con->w || h != data->con->h){
+        arcan_av_resize_begin(_this->driverdata, data->con);
+        arcan_shmif_resize(data->con, w, h);
+        arcan_av_resize_end(_this->driverdata, data->con);
+    }
+
+    if (data->server_scaled){
+        hintViewport(data->con, fullscreen ? data->disp_w : data->con->w,
+                     fullscreen ? data->disp_h : data->con->h);
+    }
+    if (!fullscreen){
+        data->server_scaled = false;
+    }
+
+/* SDL_UpdateFullscreenMode leaves the resize event to us */
+    SDL_SendWindowEvent(window, SDL_WINDOWEVENT_RESIZED,
+                        data->con->w, data->con->h);
+}
+
+/*
+ * Called from the event pump on NEWSEGMENT, returns false if [id] doesn't
+ * belong to one of our pending windows.
+ */
+bool
+Arcan_BindPendingWindow(_THIS, struct arcan_shmif_cont* prim, Uint32 id)
+{
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    struct arcan_window_slot *slot = lookupRequest(meta, id);
+    SDL_Window *window;
+    Arcan_WindowData *data;
+
+    if (!slot){
+        return false;
+    }
+
+/* destroyed while waiting, leave the segment unmapped and free the slot */
+    slot->awaiting = false;
+    window = slot->window;
+    if (!window){
+        releaseSlot(meta, slot - meta->wnd_reg);
+        return true;
+    }
+
+/* stays pending on failure, so nothing touches the unmapped segment */
+    data = window->driverdata;
+    *(data->con) = arcan_shmif_acquire(prim, NULL, SEGID_GAME, 0);
+    if (!data->con->addr){
+        SDL_SendWindowEvent(window, SDL_WINDOWEVENT_CLOSE, 0, 0);
+        return true;
+    }
+    data->pending = false;
+
+    hintRelativeWindow(data->con);
+    setupSegment(_this, window);
+    Arcan_SetWindowTitle(_this, window);
+    Arcan_BindWindowFramebuffer(_this, window);
+
+    if (data->fullscreen_deferred){
+        data->fullscreen_deferred = false;
+        applyFullscreen(_this, window, data->fullscreen_want);
+    }
+    else if (data->con->w != window->w || data->con->h != window->h){
+        SDL_SendWindowEvent(window, SDL_WINDOWEVENT_RESIZED,
+                            data->con->w, data->con->h);
+    }
+    return true;
+}
+
+/* the server said no, the window will never get a segment */
+bool
+Arcan_FailPendingWindow(_THIS, Uint32 id)
+{
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    struct arcan_window_slot *slot = lookupRequest(meta, id);
+
+    if (!slot){
+        return false;
+    }
+
+    slot->awaiting = false;
+    if (slot->window){
+        SDL_SendWindowEvent(slot->window, SDL_WINDOWEVENT_CLOSE, 0, 0);
+    }
+    else {
+        releaseSlot(meta, slot - meta->wnd_reg);
+    }
+    return true;
+}
+
 void
 Arcan_DestroyWindow(_THIS, SDL_Window* window)
 {
@@ -137,7 +391,12 @@ Arcan_DestroyWindow(_THIS, SDL_Window* window)
     Arcan_WindowData *data = window->driverdata;
     TRACE("DestroyWindow");
 
-    arcan_shmifext_drop(data->con);
+    if (data){
+        if (data->con->addr){
+            arcan_shmifext_drop(data->con);
+        }
+        Arcan_DropDeferred(window);
+    }
 
 /* FIXME: send viewport hint to hide main connection */
     if (meta->main == window){
@@ -146,8 +405,11 @@ Arcan_DestroyWindow(_THIS, SDL_Window* window)
     else {
     /* only need to clear pqueue on the mcont */
         if (data){
-            meta->wndalloc &= ~(1 << data->index);
-            arcan_shmif_drop(data->con);
+            meta->wnd_reg[data->index].window = NULL;
+            releaseSlot(meta, data->index);
+            if (data->con->addr){
+                arcan_shmif_drop(data->con);
+            }
             data->con = NULL;
         }
     }
@@ -161,13 +423,17 @@ Arcan_SetWindowFullscreen(_THIS, SDL_Window* window,
                           SDL_VideoDisplay* display,
                           SDL_bool fullscreen)
 {
-/*
- * Not our decision, we can try a viewport hint.  Some games actually track
- * this though, and repeatedly check displayBounds to see if we match.
- */
     Arcan_WindowData *data = window->driverdata;
     TRACE("SetWindowFullscreen(%d)", fullscreen);
-    arcan_shmif_resize(data->con, data->disp_w, data->disp_h);
+
+/* no segment to resize yet, the latest request is applied on binding */
+    if (data->pending){
+        data->fullscreen_deferred = true;
+        data->fullscreen_want = fullscreen;
+        return;
+    }
+
+    applyFullscreen(_this, window, fullscreen);
 }
 
 void
@@ -203,13 +469,53 @@ Arcan_HideWindow(_THIS, SDL_Window* window)
     TRACE("Hide Window");
 }
 
+/* the public struct has a fixed 64 bytes of union for every subsystem */
+SDL_COMPILE_TIME_ASSERT(arcan_wminfo_fits,
+    sizeof(((SDL_SysWMinfo*)0)->info.arcan) <= sizeof(((SDL_SysWMinfo*)0)->info.dummy));
+
 SDL_bool
 Arcan_GetWindowWMInfo(_THIS, SDL_Window* window, SDL_SysWMinfo* info)
 {
+    Arcan_SDL_Meta *meta = _this->driverdata;
+    Arcan_WindowData *data = window->driverdata;
+    const Uint32 version = SDL_VERSIONNUM((Uint32)info->version.major,
+                                          (Uint32)info->version.minor,
+                                          (Uint32)info->version.patch);
     TRACE("GetWindowWMInfo()");
+
+    if (version < SDL_VERSIONNUM(2, 31, 0)){
+        SDL_SetError("Version must be 2.31.0 or newer");
+        return false;
+    }
+
+/* a pending window has no segment yet, the counters are still valid */
+    info->subsystem = SDL_SYSWM_ARCAN;
+    info->info.arcan.segment = data->pending ? NULL : data->con;
+    info->info.arcan.audio_underruns = SDL_AtomicGet(&meta->audio_underruns);
+    info->info.arcan.audio_latency = SDL_AtomicGet(&meta->audio_latency);
+    info->info.arcan.frame_count = data->frames;
+
+    Arcan_NotePresented(window);
+    info->info.arcan.presented_pts = data->shown_pts;
+    info->info.arcan.presented_at = data->shown_at;
     return true;
 }
 
+void
+Arcan_NotePresented(SDL_Window* window)
+{
+    Arcan_WindowData *data = window->driverdata;
+
+/* the server clears vready once it has picked up what we signalled */
+    if (data->pending || !data->con->addr ||
+        data->frame_pts == data->shown_pts || data->con->addr->vready){
+        return;
+    }
+
+    data->shown_pts = data->frame_pts;
+    data->shown_at = SDL_GetTicks64();
+}
+
 void
 Arcan_SetWindowSize(_THIS, SDL_Window* window)
 {
@@ -238,6 +544,11 @@ Arcan_SetWindowTitle(_THIS, SDL_Window* window)
     struct arcan_event ev = {0};
     size_t lim=sizeof(ev.ext.message.data)/sizeof(ev.ext.message.data[1]);
 
+/* re-applied when the segment gets bound */
+    if (data->pending){
+        return;
+    }
+
     ev.ext.kind = ARCAN_EVENT(IDENT);
     snprintf((char*)ev.ext.message.data, lim, "%s",
              window->title ? window->title : "");
@@ -34,6 +34,12 @@
 extern int
 Arcan_CreateWindow(_THIS, SDL_Window* window);
 
+extern bool
+Arcan_BindPendingWindow(_THIS, struct arcan_shmif_cont* prim, Uint32 id);
+
+extern bool
+Arcan_FailPendingWindow(_THIS, Uint32 id);
+
 extern void
 Arcan_DestroyWindow(_THIS, SDL_Window* window);
 
@@ -57,6 +63,13 @@ Arcan_HideWindow(_THIS, SDL_Window* window);
 extern SDL_bool
 Arcan_GetWindowWMInfo(_THIS, SDL_Window* window, SDL_SysWMinfo* info);
 
+/*
+ * Presentation feedback, records the timestamp of the last signalled frame as
+ * shown if the server has picked it up since we last looked.
+ */
+extern void
+Arcan_NotePresented(SDL_Window* window);
+
 extern void
 Arcan_SetWindowSize(_THIS, SDL_Window* window);
 